@@ -0,0 +1,236 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef CACHE_KEY_H
+#define CACHE_KEY_H
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <functional>
+#include <type_traits>
+#include <boost/lexical_cast.hpp>
+
+/*
+ * String key for the hash map hit path:
+ *  # - hash is computed once when the key is parsed, lookups never rehash the bytes
+ *  # - keys up to mInlineCapacity bytes are kept inline so parsing/copying them does not allocate
+ *  # - equality compares hash and length before touching the bytes
+*/
+class StringKey
+{
+public:
+    static constexpr std::size_t mInlineCapacity = 22;
+
+    StringKey(){
+
+        Assign(std::string_view{});
+    }
+
+    StringKey(std::string_view p_Key){
+
+        Assign(p_Key);
+    }
+
+    StringKey(const StringKey& rhs){
+
+        Assign(rhs.view(), rhs.mHash);
+    }
+
+    StringKey(StringKey&& rhs) noexcept{
+
+        MoveFrom(rhs);
+    }
+
+    StringKey& operator=(const StringKey& rhs){
+
+        if (this != &rhs){
+
+            Reset();
+            Assign(rhs.view(), rhs.mHash);
+        }
+        return *this;
+    }
+
+    StringKey& operator=(StringKey&& rhs) noexcept{
+
+        if (this != &rhs){
+
+            Reset();
+            MoveFrom(rhs);
+        }
+        return *this;
+    }
+
+    ~StringKey(){
+
+        Reset();
+    }
+
+    std::string_view view() const{
+
+        return std::string_view(IsInline() ? mInline : mHeap, mSize);
+    }
+
+    std::size_t hash() const{
+
+        return mHash;
+    }
+
+    bool operator==(const StringKey& rhs) const{
+
+        return (mHash == rhs.mHash && mSize == rhs.mSize && std::memcmp(view().data(), rhs.view().data(), mSize) == 0);
+    }
+
+    bool operator!=(const StringKey& rhs) const{
+
+        return !(*this == rhs);
+    }
+
+    friend std::ostream& operator<<(std::ostream& s, const StringKey& p_Key){
+
+        return (s << p_Key.view());
+    }
+
+    friend std::istream& operator>>(std::istream& s, StringKey& p_Key){
+
+        std::string temp;
+        s >> temp;
+        p_Key = StringKey(temp);
+        return s;
+    }
+
+private:
+    bool IsInline() const{
+
+        return (mSize <= mInlineCapacity);
+    }
+
+    void Assign(std::string_view p_Key){
+
+        Assign(p_Key, std::hash<std::string_view>{}(p_Key));
+    }
+
+    void Assign(std::string_view p_Key, std::size_t p_Hash){
+
+        mSize = static_cast<uint32_t>(p_Key.size());
+        mHash = p_Hash;
+        char* dst = mInline;
+        if (!IsInline()){
+
+            mHeap = new char[mSize + 1];
+            dst = mHeap;
+        }
+        std::memcpy(dst, p_Key.data(), mSize);
+        dst[mSize] = '\0';
+    }
+
+    void MoveFrom(StringKey& rhs){
+
+        if (rhs.IsInline()){
+
+            Assign(rhs.view(), rhs.mHash);
+            return;
+        }
+
+        // steal the heap buffer, rhs is left as empty key
+        mHeap = rhs.mHeap;
+        mSize = rhs.mSize;
+        mHash = rhs.mHash;
+        rhs.mSize = 0;
+        rhs.mHash = std::hash<std::string_view>{}(std::string_view{});
+        rhs.mInline[0] = '\0';
+    }
+
+    void Reset(){
+
+        if (!IsInline())
+            delete[] mHeap;
+        mSize = 0;
+    }
+
+private:
+    std::size_t mHash = 0;
+    uint32_t mSize = 0;
+    union{
+
+        char mInline[mInlineCapacity + 1];
+        char* mHeap;
+    };
+};
+
+namespace std {
+
+template<>
+struct hash<StringKey>{
+
+    std::size_t operator()(const StringKey& p_Key) const noexcept{
+
+        return p_Key.hash();
+    }
+};
+
+}
+
+/*
+ * How a key addresses the items file:
+ * line_addressable keys index the legacy fixed width file (10000 lines), every other key
+ * is serialized with ToRecordKey and addresses a VARIABLE_LENGTH record
+*/
+template<typename Key, typename = void>
+struct KeyTraits{
+
+    static constexpr bool line_addressable = false;
+
+    static Key Parse(std::string_view p_Text){
+
+        return Key(p_Text);
+    }
+
+    static std::string ToRecordKey(const Key& p_Key){
+
+        return std::string(p_Key.view());
+    }
+};
+
+template<typename Key>
+struct KeyTraits<Key, std::enable_if_t<std::is_integral_v<Key>>>{
+
+    static constexpr bool line_addressable = (sizeof(Key) <= sizeof(short));
+
+    static Key Parse(std::string_view p_Text){
+
+        return boost::lexical_cast<Key>(p_Text);
+    }
+
+    static std::string ToRecordKey(const Key& p_Key){
+
+        return std::to_string(p_Key);
+    }
+};
+
+#endif // CACHE_KEY_H
@@ -30,26 +30,57 @@
 #include <unordered_map>
 #include <iostream>
 #include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <algorithm>
+#include <cassert>
 #include <thread>
 #include <vector>
 #include <atomic>
+#include <limits>
 #include <boost/range/adaptor/indexed.hpp>
 #include <boost/range/adaptor/filtered.hpp>
 
 #include "fileutility.h"
 #include "utilstructs.h"
+#include "cachekey.h"
+#include "slaballocator.h"
+#include "valuestorage.h"
+#include "timerwheel.h"
+#include "readahead.h"
+#include "readbuffer.h"
+#include "topology.h"
+#include "writeback.h"
+#include "hugepages.h"
+#include "evictionkeys.h"
+#include "readindex.h"
+#include "warmtier.h"
+#include "mrcprofiler.h"
+#include "singleflight.h"
+#include "perfcounters.h"
+#include "tracer.h"
 #include "config.h"
-
-template<ALGO policy, typename Key, typename Value, template<class, class> class HashMapStrorage = std::unordered_map>
+#include "sharedcache.h"
+
+/*
+ * Policy independent part of the cache. Derived is the policy implementation (CRTP) so calls into
+ * the policy (buffer access, victim search) are bound at compile time and can be inlined
+*/
+template<ALGO policy, typename Derived, typename Key, typename Value, template<class, class> class HashMapStrorage = std::unordered_map,
+         SLOT_LAYOUT layout = SLOT_LAYOUT::PADDED>
 class ICacheInterfaceImp : public ICacheInterface<Key, Value>
 {
 protected:
     using key_type = typename HashMapStrorage<Key, Value>::key_type;
     using value_type = typename HashMapStrorage<Key, Value>::mapped_type;
     using kernel_parameter_cache_size = std::size_t;
-    using CacheBufferType = typename FreeListContentType<policy, Key, Value>::type;
-    using freebuffer_list_type = std::vector<std::atomic<CacheBufferType>>;
+    using value_storage = ValueStorage<Value>;
+    using stored_value_type = typename value_storage::stored_type;
+    using CacheBufferType = typename FreeListContentType<policy, Key, stored_value_type, layout>::type;
+    using freebuffer_list_type = std::vector<std::atomic<CacheBufferType>, HugePageAllocator<std::atomic<CacheBufferType>>>;
+    using buffer_key_list_type = std::vector<key_type, HugePageAllocator<key_type>>;
     using buffer_cache_index = signed int;
+    using time_to_live_type = std::chrono::milliseconds;
 
 public:
     enum class BUFFER_STATUS: int8_t{
@@ -57,30 +88,75 @@ public:
         // life cycle of cache buffer in free list
         FREE=0,
         BUSY,
-        DIRTY,
-        VALID,
+        DIRTY,                  //newer than the items file
+        VALID,                  //same as the items file: loaded on a miss, written back or updated to the same value
     };
 
-    explicit ICacheInterfaceImp(kernel_parameter_cache_size p_Maxsize, const std::string& p_FileName)
-        :mNumberOfBuffers(p_Maxsize), mFileUtility(p_FileName){}
+    /*
+     * p_Maxsize buffers are used right away, p_Capacity (if bigger) are reserved so Resize can grow
+     * the cache up to it without moving any buffer, reserved ones stay FREE until then
+    */
+    explicit ICacheInterfaceImp(kernel_parameter_cache_size p_Maxsize, const std::string& p_FileName, HUGE_PAGES p_HugePages = HUGE_PAGES::OFF,
+                                kernel_parameter_cache_size p_Capacity = 0)
+        :mNumberOfBuffers(std::max(p_Maxsize, p_Capacity)), mActiveBuffers(p_Maxsize),
+          mFreeList(mNumberOfBuffers, HugePageAllocator<std::atomic<CacheBufferType>>(p_HugePages, &mHugePages)),
+          mEvictionKeys(layout == SLOT_LAYOUT::DENSE ? mNumberOfBuffers : 0), mFileUtility(p_FileName, mRecordFormat),
+          mBufferKeys(mNumberOfBuffers, HugePageAllocator<key_type>(p_HugePages, &mHugePages)),
+          mReadIndex(mNumberOfBuffers), mTimerWheel(mNumberOfBuffers), mPrefetched(new std::atomic<bool>[mNumberOfBuffers]),
+          mDirtySince(new std::atomic<int64_t>[mNumberOfBuffers]), mBufferVersions(new std::atomic<uint32_t>[mNumberOfBuffers]){
+
+        // item file is hit as randomly as the buffers, THP for file mappings needs kernel support so it may be refused
+        if (p_HugePages != HUGE_PAGES::OFF)
+            mHugePages.transparent |= mFileUtility.AdviseHugePages();
+
+        // every buffer starts FREE so hand them out without running the eviction algorithm
+        for (buffer_cache_index i = (buffer_cache_index)mNumberOfBuffers - 1; i >= 0; --i){
+
+            if (i < (buffer_cache_index)p_Maxsize)
+                mReclaimedBuffers.push_back(i);
+            mPrefetched[i].store(false, std::memory_order_relaxed);
+            mDirtySince[i].store(0, std::memory_order_relaxed);
+            mBufferVersions[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * @brief       This Method will hand out a buffer to fill, FREE buffers (never used, expired or
+     *              evicted for memory budget) first otherwise run the eviction algorithm
+     *
+     * @return      buffer free list index which is free to use (status BUSY)
+    */
+    buffer_cache_index GetNewBufferFromCache(){
+
+        TraceSpan span(TRACE_EVENT::GET_NEW_BUFFER);
+        // reclaimed buffers are FREE already, no need to scan for a victim
+        buffer_cache_index reclaimed_buffer_index = PopReclaimedBuffer();
+        if (reclaimed_buffer_index != INVALID_INDEX)
+            return reclaimed_buffer_index;
+
+        return EvictBuffer();
+    }
 
     /*
      * @brief       This Method will perform provided eviction algorithm
-     *              # - find the buffer least frequently used
+     *              # - find the buffer least frequently used and mark it BUSY so no other thread can claim it
      *              # - flush the data to physical file if its status is DIRTY
-     *              # - set the buffer status to FREE
+     *              # - drop the buffer from hash map and release its payload
      *
-     * @return      buffer free list index which is free to use
+     * @return      buffer free list index which is free to use (status BUSY)
     */
-    buffer_cache_index GetNewBufferFromCache(){
+    buffer_cache_index EvictBuffer(){
 
+        PerfCounters::Measurement measurement(mPerfCounters, PERF_OPERATION::EVICT);
+        TraceSpan span(TRACE_EVENT::EVICT);
         //this for loop is required because if CAS fail need to recompute all over again
         for(;;){
 
-            buffer_cache_index least_frequently_used_buffer_index = mEvictionAlgo();
+            buffer_cache_index least_frequently_used_buffer_index = Policy().FindVictim();
             if (least_frequently_used_buffer_index == INVALID_INDEX){
 
                 //std::cout << "All buffers are BUSY" << std::endl;
+                TraceSpan backoff(TRACE_EVENT::RETRY_SLEEP);
                 std::this_thread::sleep_for(30ms);
                 continue;
             }
@@ -88,261 +164,1390 @@ public:
 
             std::atomic<CacheBufferType>& cache = mFreeList[least_frequently_used_buffer_index];
             CacheBufferType buf_to_evict = cache.load(std::memory_order_acquire);
-            CacheBufferType old_cache = buf_to_evict;
-            BUFFER_STATUS old_status = (BUFFER_STATUS)buf_to_evict.status;
-            buf_to_evict.status = (short)BUFFER_STATUS::FREE;
-            if(!cache.compare_exchange_strong(old_cache,buf_to_evict)){
+            CacheBufferType claimed_buf;
+            claimed_buf.status = (short)BUFFER_STATUS::BUSY;
+            claimed_buf.frequency = 0;
+            if(buf_to_evict.status == (short)BUFFER_STATUS::BUSY || !cache.compare_exchange_strong(buf_to_evict,claimed_buf)){
 
                 //some other thread must have already modified this buffer so recompute again
+                TraceSpan backoff(TRACE_EVENT::RETRY_SLEEP, least_frequently_used_buffer_index);
                 std::this_thread::sleep_for(30ms);
                 continue;
             }
+            SyncEvictionKey(least_frequently_used_buffer_index);
+            if (buf_to_evict.status == (short)BUFFER_STATUS::DIRTY){
 
-            std::unique_lock lk(mHashMapMutex);
-            auto itr = std::find_if(mCachedMemBlocks.begin(), mCachedMemBlocks.end(),
-                                    [least_frequently_used_buffer_index](auto &item){
+                // this eviction pays for a synchronous write, get the next victims cleaned ahead
+                mDirtyEvictions.fetch_add(1, std::memory_order_relaxed);
+                mWritebackTrigger.Notify(WritebackTrigger::DIRTY_EVICTION);
+            }else{
 
-                return(item.second == least_frequently_used_buffer_index);
-            });
+                mCleanEvictions.fetch_add(1, std::memory_order_relaxed);
+            }
+            DropBuffer(least_frequently_used_buffer_index, buf_to_evict, true);
+
+            return least_frequently_used_buffer_index;
+        }
+    }
+
+    /*
+     * @brief       This Method will get the value from cache if cache miss happens
+     *              data is loaded from physical file and update the cache
+     *
+     * @return      data at specified line p_Position
+    */
+    virtual const bool Get(const key_type& p_Position, value_type& p_PositionValue) {
+
+        bool cache_miss_happened = false;
+        bool stream_access = false;
+
+        // hits are served without mHashMapMutex, the locked path below handles everything else
+        if (GetLockFree(p_Position, p_PositionValue, stream_access)){
+
+            if (stream_access)
+                ObserveStream(p_Position);
+            return cache_miss_happened;
+        }
+
+        auto lk = AcquireTraced<std::shared_lock<std::shared_mutex>>(mHashMapMutex, TRACE_EVENT::MAP_LOCK);
+        for (;;){
+
+            auto itr = mCachedMemBlocks.find(p_Position);
+            if(itr == mCachedMemBlocks.end()){
+
+                cache_miss_happened = true;
+                bool loaded_meanwhile = false;
+                lk.unlock();
+
+                // one load per key, later misses wait for it instead of evicting and reading again
+                auto flight = mInFlightMisses.Join(p_Position);
+                if (!flight.Leader()){
+
+                    flight.Wait();
+                    cache_miss_happened = false;
+                    lk.lock();
+                    continue;
+                }
+
+                while(true){
+
+                    buffer_cache_index new_buf_index = this->GetNewBufferFromCache();
+                    assert(new_buf_index < this->mNumberOfBuffers);
+
+                    auto ulk = AcquireTraced<std::unique_lock<std::shared_mutex>>(mHashMapMutex, TRACE_EVENT::MAP_LOCK);
+
+                    // readahead (or another miss) loaded it while this thread was getting a buffer
+                    if (mCachedMemBlocks.find(p_Position) != mCachedMemBlocks.end()){
+
+                        ulk.unlock();
+                        ReclaimBuffer(new_buf_index);
+                        loaded_meanwhile = true;
+                        break;
+                    }
+
+                    auto &new_cache = mFreeList.at(new_buf_index);
+                    CacheBufferType new_buf = new_cache.load(std::memory_order_acquire);
+                    CacheBufferType to_update_buf;
+                    //read the value from warm tier or file, a warm hit is promoted to this buffer
+                    std::string record;
+                    if (!mWarmTier.Take(p_Position, record))
+                        mFileUtility.ReadItem(p_Position, record);
+                    mMissLoads.fetch_add(1, std::memory_order_relaxed);
+                    value_storage::Parse(record, p_PositionValue);
+                    to_update_buf.data = value_storage::Store(mSlabAllocator, p_PositionValue);
+                    // loaded copy is what the items file (or the clean warm copy) holds, eviction can just drop it
+                    to_update_buf.status = (short)BUFFER_STATUS::VALID;
+                    to_update_buf.frequency = 1;
+                    if(!new_cache.compare_exchange_strong(new_buf,to_update_buf) == true){
+
+                        //std::cout <<"buf consumed re-comute" << std::endl;
+                        value_storage::Release(mSlabAllocator, to_update_buf.data);
+                        ulk.unlock();
+                        TraceSpan backoff(TRACE_EVENT::RETRY_SLEEP, new_buf_index);
+                        std::this_thread::sleep_for(10ms);
+                        continue;
+                    }
+
+                    SyncEvictionKey(new_buf_index);
+
+                    // Update quick tracker
+                    mCachedMemBlocks[p_Position] = new_buf_index;
+                    mBufferKeys[new_buf_index] = p_Position;
+                    mReadIndex.Insert(p_Position, new_buf_index, mBufferVersions[new_buf_index].load(std::memory_order_relaxed));
+                    mNumberOfMappedBuffers.store(mCachedMemBlocks.size(), std::memory_order_relaxed);
+                    mTimerWheel.Schedule(new_buf_index, mDefaultTimeToLive);
+                    mCleanLoads.fetch_add(1, std::memory_order_relaxed);
+                    stream_access = true;
+                    break;
+                }
+
+                if (loaded_meanwhile){
+
+                    cache_miss_happened = false;
+                    lk.lock();
+                    continue;
+                }
+            }else{
+
+                // expired but background thread did not reclaim it yet
+                if (mTimerWheel.IsExpired(itr->second)){
+
+                    const buffer_cache_index expired_index = itr->second;
+                    lk.unlock();
+                    ExpireBuffer(expired_index, mTimerWheel.Deadline(expired_index));
+                    lk.lock();
+                    continue;
+                }
+
+                // Atomic read no need explicit lock;
+                if (!Policy().GetCachedValue(itr->second, p_PositionValue)){
+
+                    // buffer is being evicted, let the evicting thread drop the mapping
+                    lk.unlock();
+                    std::this_thread::yield();
+                    lk.lock();
+                    continue;
+                }
+
+                // first use of a prefetched key keeps its stream window sliding
+                std::atomic<bool>& prefetched = mPrefetched[itr->second];
+                if (prefetched.load(std::memory_order_relaxed) && prefetched.exchange(false, std::memory_order_relaxed)){
+
+                    mPrefetchUsed.fetch_add(1, std::memory_order_relaxed);
+                    stream_access = true;
+                }
+            }
+            break;
+        }
+        if (lk.owns_lock())
+            lk.unlock();
+
+        if (stream_access)
+            ObserveStream(p_Position);
+
+        if (cache_miss_happened)
+            EnforceMemoryBudget();
+
+        return cache_miss_happened;
+    }
+
+    /*
+     * @brief       Get for callers that must tell a missing key from a default value (server front end),
+     *              keys that are neither cached nor stored in the items file are not admitted
+     *
+     * @return      true if p_Value holds the value of p_Position
+    */
+    virtual bool Lookup(const key_type& p_Position, value_type& p_Value){
+
+        bool cached;
+        for (;;){
+
+            std::shared_lock lk(mHashMapMutex);
+            auto itr = mCachedMemBlocks.find(p_Position);
+            cached = (itr != mCachedMemBlocks.end());
+            if (!cached || !mTimerWheel.IsExpired(itr->second))
+                break;
+
+            // expire it first so a removing expiry is not answered from the items file
+            const buffer_cache_index expired_index = itr->second;
+            lk.unlock();
+            ExpireBuffer(expired_index, mTimerWheel.Deadline(expired_index));
+        }
+        std::string record;
+        if (!cached && !mFileUtility.ReadItem(p_Position, record))
+            return false;
+
+        ICacheInterfaceImp::Get(p_Position, p_Value);
+        return true;
+    }
+
+    /*
+     * @brief       drop p_Position from cache and items file, a dirty value is not written back
+     *
+     * @return      true if the key existed in either
+    */
+    virtual bool Remove(const key_type& p_Position){
+
+        const bool removed = DropCachedCopy(p_Position);
+
+        // a write back racing with the removal finished before DropBuffer got the map exclusive
+        mWarmTier.Erase(p_Position);
+        return (mFileUtility.EraseItem(p_Position) || removed);
+    }
+
+    /*
+     * @brief       This Method will put the value to the cache and update frequency
+     *              if cache miss happens data is loaded from physical file and cache is updated
+     *
+     * @return      void
+    */
+    virtual void Put(const key_type& p_Position, const value_type& p_Value){
+
+        ICacheInterfaceImp::Put(p_Position, p_Value, mDefaultTimeToLive);
+    }
+
+    /*
+     * @brief       Put with explicit time to live, entry is reclaimed once it expires (zero never expires)
+     *
+     * @return      void
+    */
+    virtual void Put(const key_type& p_Position, const value_type& p_Value, time_to_live_type p_TimeToLive){
+
+        // a line number past the items file could never be written back
+        if (!mFileUtility.Stores(p_Position))
+            return;
+
+        // no buffer at all, nothing to expire either
+        const WRITE_MODE write_mode = mWriteMode.load(std::memory_order_relaxed);
+        if (write_mode == WRITE_MODE::WRITE_AROUND){
+
+            WriteAround(p_Position, p_Value);
+            return;
+        }
+
+        // written back before the map lock is released, so the buffer still holds p_Position
+        const bool write_through = (write_mode == WRITE_MODE::WRITE_THROUGH);
+        auto lk = AcquireTraced<std::shared_lock<std::shared_mutex>>(mHashMapMutex, TRACE_EVENT::MAP_LOCK);
+        for (;;){
+
+            auto itr = mCachedMemBlocks.find(p_Position);
+            if(itr == mCachedMemBlocks.end()){
+
+                bool loaded_meanwhile = false;
+                lk.unlock();
+
+                while(true){
+
+                    buffer_cache_index new_buf_index = this->GetNewBufferFromCache();
+                    assert(new_buf_index < this->mNumberOfBuffers);
+
+                    auto ulk = AcquireTraced<std::unique_lock<std::shared_mutex>>(mHashMapMutex, TRACE_EVENT::MAP_LOCK);
+
+                    // readahead (or another miss) loaded it meanwhile, update that buffer instead
+                    if (mCachedMemBlocks.find(p_Position) != mCachedMemBlocks.end()){
+
+                        ulk.unlock();
+                        ReclaimBuffer(new_buf_index);
+                        loaded_meanwhile = true;
+                        break;
+                    }
+
+                    auto &new_cache = mFreeList.at(new_buf_index);
+                    CacheBufferType new_buf = new_cache.load(std::memory_order_acquire);
+                    CacheBufferType to_update_buf;
+                    to_update_buf.data = value_storage::Store(mSlabAllocator, p_Value);
+                    to_update_buf.status = (short)BUFFER_STATUS::DIRTY;
+                    to_update_buf.frequency = 1;
+                    if(!new_cache.compare_exchange_strong(new_buf,to_update_buf) == true){
+
+                        //std::cout <<"buf consumed re-comute" << std::endl;
+                        value_storage::Release(mSlabAllocator, to_update_buf.data);
+                        ulk.unlock();
+                        TraceSpan backoff(TRACE_EVENT::RETRY_SLEEP, new_buf_index);
+                        std::this_thread::sleep_for(10ms);
+                        continue;
+                    }
+
+                    SyncEvictionKey(new_buf_index);
+
+                    // Update quick tracker
+                    mCachedMemBlocks[p_Position] = new_buf_index;
+                    mBufferKeys[new_buf_index] = p_Position;
+                    mReadIndex.Insert(p_Position, new_buf_index, mBufferVersions[new_buf_index].load(std::memory_order_relaxed));
+                    mWarmTier.Erase(p_Position);
+                    mNumberOfMappedBuffers.store(mCachedMemBlocks.size(), std::memory_order_relaxed);
+                    mTimerWheel.Schedule(new_buf_index, p_TimeToLive);
+                    MarkDirty(new_buf_index);
+                    if (write_through && WritebackMappedBuffer(new_buf_index))
+                        mWrittenThrough.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+
+                if (loaded_meanwhile){
+
+                    lk.lock();
+                    continue;
+                }
+            }else{
+
+                // Atomic update no need explicit lock;
+                if (!Policy().SetCachedValue((*itr).second, p_Value)){
+
+                    // buffer is being evicted, retry once the mapping is dropped
+                    lk.unlock();
+                    std::this_thread::yield();
+                    lk.lock();
+                    continue;
+                }
+                // still holding the map shared so eviction can not cancel the timer before this
+                mTimerWheel.Schedule((*itr).second, p_TimeToLive);
+                // and can not hand the buffer to another key before it is written
+                if (write_through && WritebackMappedBuffer((*itr).second))
+                    mWrittenThrough.fetch_add(1, std::memory_order_relaxed);
+            }
+            break;
+        }
+        if (lk.owns_lock())
+            lk.unlock();
+
+        // payload of an update might have grown as well
+        EnforceMemoryBudget();
+    }
+
+    /*
+     * @brief       advance the timer wheel and reclaim every expired buffer to FREE
+     *              called by the background thread every timer wheel tick
+     *
+     * @return      number of buffers reclaimed
+    */
+    std::size_t AdvanceTimers(){
+
+        std::size_t reclaimed = 0;
+        mTimerWheel.Advance([this, &reclaimed](buffer_cache_index p_Index, TimerWheel::tick_type p_Deadline){
+
+            if (ExpireBuffer(p_Index, p_Deadline))
+                reclaimed++;
+        });
+
+        // read index nodes no reader can reach any more
+        EpochDomain::Global().Reclaim();
+        return reclaimed;
+    }
+
+    void SetDefaultTimeToLive(time_to_live_type p_TimeToLive){
+
+        mDefaultTimeToLive = p_TimeToLive;
+    }
+
+    // expired entries are removed from the items file as well instead of written back (memcached exptime)
+    void SetExpiryRemoves(bool p_Remove){
+
+        mExpiryRemoves = p_Remove;
+    }
+
+    TimerWheel::resolution_type TimerResolution() const{
+
+        return mTimerWheel.Resolution();
+    }
+
+    // 0 disables the byte budget, capacity is then only the number of buffers
+    void SetMemoryBudget(std::size_t p_Bytes){
+
+        mMemoryBudget = p_Bytes;
+        if (p_Bytes){
+
+            // reserved slab pages count against the budget, keep one page a small part of it
+            mSlabAllocator.SetPageSize(p_Bytes / mBudgetBytesPerSlabPage);
+        }
+        mSlabAllocator.ReleaseEmptyPages(p_Bytes != 0);
+        EnforceMemoryBudget();
+    }
+
+    // bytes of the compressed tier evicted entries go to, 0 disables it
+    void SetWarmTierBudget(std::size_t p_Bytes){
+
+        mWarmTier.SetBudget(p_Bytes);
+    }
+
+    WarmTierStats WarmTierStatistics() const{
+
+        return mWarmTier.Statistics();
+    }
+
+    // null stops measuring, p_Counters must outlive the cache
+    void SetPerfCounters(PerfCounters* p_Counters){
+
+        mPerfCounters = p_Counters;
+    }
+
+    MissStats MissStatistics() const{
+
+        MissStats stats;
+        stats.loads = mMissLoads.load(std::memory_order_relaxed);
+        stats.coalesced = mInFlightMisses.Coalesced();
+        return stats;
+    }
+
+    /*
+     * @brief       change the number of buffers in use, up to the capacity reserved at construction
+     *              # - growing hands the FREE buffers up to p_NumberOfBuffers out right away
+     *              # - shrinking only lowers the target, RelocateBuffers empties the buffers above it
+     *                  in the background so Get/Put are never held off for the whole shrink
+     *
+     * @return      false if p_NumberOfBuffers is 0 or more than the reserved capacity
+    */
+    bool Resize(kernel_parameter_cache_size p_NumberOfBuffers){
+
+        if (p_NumberOfBuffers == 0 || p_NumberOfBuffers > mNumberOfBuffers)
+            return false;
+
+        std::lock_guard lk(mResizeGuard);
+        const kernel_parameter_cache_size previous = mActiveBuffers.exchange(p_NumberOfBuffers, std::memory_order_acq_rel);
+        std::lock_guard reclaimed_lk(mReclaimedBuffersGuard);
+        if (p_NumberOfBuffers < previous){
+
+            // retired buffers must not be handed out any more
+            mReclaimedBuffers.erase(std::remove_if(mReclaimedBuffers.begin(), mReclaimedBuffers.end(), [p_NumberOfBuffers](buffer_cache_index p_Index){
+
+                return (p_Index >= (buffer_cache_index)p_NumberOfBuffers);
+            }), mReclaimedBuffers.end());
+        }else{
+
+            // buffers a shrink did not empty yet are still in use, the FREE ones become available
+            for (buffer_cache_index index = (buffer_cache_index)p_NumberOfBuffers - 1; index >= (buffer_cache_index)previous; --index)
+                if (mFreeList[index].load(std::memory_order_acquire).status == (short)BUFFER_STATUS::FREE)
+                    mReclaimedBuffers.push_back(index);
+        }
+        return true;
+    }
+
+    /*
+     * @brief       one background step of a shrink, for every used buffer above the target a buffer below
+     *              it is made free the usual way (so the coldest entry of the whole cache is evicted) and
+     *              the entry above is moved into it unless it was the one evicted
+     *
+     * @return      number of buffers above the target emptied, 0 once there is nothing left to do
+    */
+    std::size_t RelocateBuffers(std::size_t p_MaxBuffers){
 
-            //check if buffer have cached data of some mem block but not yet flushed to physical file
-            std::pair<key_type, std::string> dirtyCacheData{-1,"-1"};
-            if (itr != mCachedMemBlocks.end()){
+        std::lock_guard lk(mResizeGuard);
+        const buffer_cache_index target = (buffer_cache_index)mActiveBuffers.load(std::memory_order_acquire);
+        std::size_t emptied = 0;
+        for (buffer_cache_index index = (buffer_cache_index)mNumberOfBuffers - 1; index >= target && emptied < p_MaxBuffers; --index){
 
-                if(old_status == BUFFER_STATUS::DIRTY){
+            const CacheBufferType temp = mFreeList[index].load(std::memory_order_acquire);
+            // BUSY ones are being evicted or filled, they are looked at again next step
+            if (temp.status == (short)BUFFER_STATUS::FREE || temp.status == (short)BUFFER_STATUS::BUSY)
+                continue;
+
+            const buffer_cache_index free_index = GetNewBufferFromCache();
+            if (free_index >= target || !MoveBuffer(index, free_index))
+                ReclaimBuffer(free_index);
+            emptied++;
+        }
+        return emptied;
+    }
+
+    // buffers in use, the target of the last Resize
+    kernel_parameter_cache_size NumberOfBuffers() const{
+
+        return mActiveBuffers.load(std::memory_order_acquire);
+    }
+
+    CacheMemoryUsage MemoryUsage() const{
+
+        CacheMemoryUsage usage;
+        usage.bufferBytes = mNumberOfBuffers * mFixedBytesPerBuffer;
+        usage.indexBytes = mNumberOfMappedBuffers.load(std::memory_order_relaxed) * mIndexBytesPerEntry;
+        usage.payloadBytes = mSlabAllocator.UsedBytes();
+        usage.reservedPayloadBytes = mSlabAllocator.ReservedBytes();
+        usage.budgetBytes = mMemoryBudget;
+        usage.numberOfEntries = mNumberOfMappedBuffers.load(std::memory_order_relaxed);
+        usage.hugePages = mHugePages;
+        if (mHugePages.mappedBytes){
+
+            usage.hugePages.backedBytes = HugePageBackedBytes(mFreeList.data(), mFreeList.size() * sizeof(mFreeList[0])) +
+                                          HugePageBackedBytes(mBufferKeys.data(), mBufferKeys.size() * sizeof(key_type));
+        }
+        usage.hugePages.itemFileBackedBytes = mFileUtility.HugePageBackedBytes();
+        return usage;
+    }
+
+    /*
+     * @brief       most buffers a byte budget can hold, assuming the smallest payload per entry
+     *              bigger payloads make EnforceMemoryBudget evict before all of them are used
+     *
+     * @return      number of buffers to construct the cache with
+    */
+    static kernel_parameter_cache_size BuffersForMemoryBudget(std::size_t p_Bytes){
+
+        const std::size_t min_payload = value_storage::fits_fixed_width ? 0 : SlabAllocator::mMinChunkSize;
+        return std::max<std::size_t>(1, p_Bytes / (mFixedBytesPerBuffer + mIndexBytesPerEntry + min_payload));
+    }
+
+    /*
+     * @brief       place free list and reverse index on the NUMA nodes of the threads using the cache
+     *
+     * @return      true if the kernel accepted the placement
+    */
+    bool PlaceMemory(const std::vector<int>& p_Nodes){
+
+        const bool free_list_placed = BindMemoryToNodes(mFreeList.data(), mFreeList.size() * sizeof(mFreeList[0]), p_Nodes);
+        const bool keys_placed = BindMemoryToNodes(mBufferKeys.data(), mBufferKeys.size() * sizeof(key_type), p_Nodes);
+        return (free_list_placed && keys_placed);
+    }
+
+    // number of keys a detected stream is prefetched ahead, 0 disables readahead
+    void SetReadahead(std::size_t p_Depth){
+
+        mStreamDetector.SetDepth(std::is_integral_v<key_type> ? p_Depth : 0);
+    }
+
+    /*
+     * @brief       load the windows queued by detected streams, waits up to p_MaxWait for the first
+     *              called by the readahead thread in a loop
+     *
+     * @return      number of keys admitted to cache
+    */
+    std::size_t Readahead(std::chrono::milliseconds p_MaxWait){
+
+        const std::size_t admitted_before = mPrefetchAdmitted.load(std::memory_order_relaxed);
+        PrefetchWindow window;
+        while (mPrefetchQueue.Pop(window, p_MaxWait)){
+
+            for (const auto& key : WindowKeys(window)){
+
+                if (!AdmitPrefetched(key))
+                    break;
+            }
+            // drain whatever else is queued without waiting
+            p_MaxWait = std::chrono::milliseconds(0);
+        }
+
+        const std::size_t admitted = mPrefetchAdmitted.load(std::memory_order_relaxed) - admitted_before;
+        if (admitted)
+            EnforceMemoryBudget();
+        return admitted;
+    }
+
+    ReadaheadStats ReadaheadStatistics() const{
+
+        ReadaheadStats stats;
+        stats.admitted = mPrefetchAdmitted.load(std::memory_order_relaxed);
+        stats.used = mPrefetchUsed.load(std::memory_order_relaxed);
+        return stats;
+    }
 
-                    //backup data to flush
-                    dirtyCacheData = std::make_pair((*itr).first, std::to_string(old_cache.data));
-                    //also erase the cache reference from hash map
-                    mCachedMemBlocks.erase(itr);
+    /*
+     * @brief       This Method will write back every dirty buffer to storage
+     *              used on shutdown, writeback thread normally only writes what its policy asks for
+     *
+     * @return      void
+    */
+    void Flush(){
+
+        PerfCounters::Measurement measurement(mPerfCounters, PERF_OPERATION::FLUSH);
+        TraceSpan span(TRACE_EVENT::FLUSH, mNumberOfBuffers);
+        for (buffer_cache_index index = 0; index < (buffer_cache_index)mNumberOfBuffers; ++index)
+            WritebackBuffer(index);
+    }
+
+    void SetWritebackPolicy(const WritebackPolicy& p_Policy){
+
+        mWritebackPolicy = p_Policy;
+        mWritebackRateLimiter.SetRate(p_Policy.buffersPerSecond);
+    }
+
+    // may change while Puts run, buffers already DIRTY are left to the writeback thread
+    bool SetWriteMode(WRITE_MODE p_Mode){
+
+        mWriteMode.store(p_Mode, std::memory_order_relaxed);
+        return true;
+    }
+
+    /*
+     * @brief       one pass of the writeback scheduler, waits up to p_MaxWait to be triggered
+     *              # - every interval (or when triggered) buffers dirty longer than delayed write age
+     *              # - over the dirty ratio lowest frequency dirty buffers until back under half of it
+     *              # - after a dirty eviction a small batch of the next likely victims
+     *              all of it limited by the writeback rate
+     *
+     * @return      number of buffers written back
+    */
+    std::size_t Writeback(std::chrono::milliseconds p_MaxWait){
+
+        const uint32_t reasons = mWritebackTrigger.Wait(p_MaxWait);
+        const auto now = std::chrono::steady_clock::now();
+        if (reasons == WritebackTrigger::NONE && now - mLastWritebackScan < mWritebackPolicy.interval)
+            return 0;
+        mLastWritebackScan = now;
+
+        struct DirtyBuffer{
+
+            buffer_cache_index index;
+            short frequency;
+            int64_t dirtySince;
+        };
+        std::vector<DirtyBuffer> aged, others;
+        const int64_t aged_before = DirtyClock() - mWritebackPolicy.delayedWriteAge.count();
+        for (buffer_cache_index index = 0; index < (buffer_cache_index)mNumberOfBuffers; ++index){
+
+            CacheBufferType temp = mFreeList[index].load(std::memory_order_acquire);
+            if (temp.status != (short)BUFFER_STATUS::DIRTY)
+                continue;
+            const DirtyBuffer dirty{index, temp.frequency, mDirtySince[index].load(std::memory_order_relaxed)};
+            (dirty.dirtySince <= aged_before ? aged : others).push_back(dirty);
+        }
+
+        // oldest first, then in the order eviction would pick them
+        std::sort(aged.begin(), aged.end(), [](const DirtyBuffer& lhs, const DirtyBuffer& rhs){ return lhs.dirtySince < rhs.dirtySince; });
+        std::sort(others.begin(), others.end(), [](const DirtyBuffer& lhs, const DirtyBuffer& rhs){ return lhs.frequency < rhs.frequency; });
+
+        std::size_t wanted = aged.size();
+        const std::size_t dirty_limit = DirtyLimit();
+        const std::size_t dirty = aged.size() + others.size();
+        if (dirty >= dirty_limit && mWritebackPolicy.dirtyRatio > 0)
+            wanted = std::max(wanted, dirty - (dirty_limit / 2));
+        if (reasons & WritebackTrigger::DIRTY_EVICTION)
+            wanted = std::max(wanted, std::min(dirty, aged.size() + mCleanAheadBatch));
+        aged.insert(aged.end(), others.begin(), others.end());
+
+        std::size_t written = 0;
+        const std::size_t allowed = mWritebackRateLimiter.Acquire(std::min(wanted, aged.size()));
+        for (std::size_t i = 0; i < allowed; ++i)
+            if (WritebackBuffer(aged[i].index))
+                written++;
+        return written;
+    }
+
+    /*
+     * @brief       call p_Visitor with (key, value, frequency, dirty) of every resident entry, runs next to Get/Put
+     *              # - each entry is copied from one load of its buffer, key only while the buffer is still
+     *                  mapped to it and variable length payloads through the slab generation check,
+     *                  a buffer updated between the loads is read again
+     *              # - map is held shared for mSnapshotBatch buffers at a time so misses are only held off
+     *                  for a batch, hits do not take it at all, p_Visitor runs without it
+     *              entries inserted or evicted while walking may or may not be visited, none is visited twice
+     *
+     * @return      number of entries visited, p_Visitor returning false stops the walk
+    */
+    std::size_t ForEachEntry(const std::function<bool(const CacheEntry<key_type, value_type>&)>& p_Visitor){
+
+        // frequencies include hits that are still buffered
+        Policy().DrainReadBuffers();
+
+        std::size_t visited = 0;
+        std::vector<CacheEntry<key_type, value_type>> batch;
+        batch.reserve(std::min<std::size_t>(mSnapshotBatch, mNumberOfBuffers));
+        for (buffer_cache_index first = 0; first < (buffer_cache_index)mNumberOfBuffers; first += mSnapshotBatch){
+
+            batch.clear();
+            {
+                std::shared_lock lk(mHashMapMutex);
+                const buffer_cache_index last = std::min<buffer_cache_index>(first + mSnapshotBatch, mNumberOfBuffers);
+                for (buffer_cache_index index = first; index < last; ++index){
+
+                    CacheEntry<key_type, value_type> entry;
+                    if (CopyEntry(index, entry))
+                        batch.push_back(std::move(entry));
                 }
             }
 
-            lk.unlock();
+            for (const auto& entry : batch){
+
+                visited++;
+                if (!p_Visitor(entry))
+                    return visited;
+            }
+        }
+        return visited;
+    }
+
+    WritebackStats WritebackStatistics() const{
+
+        WritebackStats stats;
+        stats.dirtyBuffers = mNumberOfDirtyBuffers.load(std::memory_order_relaxed);
+        stats.written = mBuffersWritten.load(std::memory_order_relaxed);
+        stats.writtenThrough = mWrittenThrough.load(std::memory_order_relaxed);
+        stats.writtenAround = mWrittenAround.load(std::memory_order_relaxed);
+        stats.dirtyEvictions = mDirtyEvictions.load(std::memory_order_relaxed);
+        stats.cleanEvictions = mCleanEvictions.load(std::memory_order_relaxed);
+        stats.cleanLoads = mCleanLoads.load(std::memory_order_relaxed);
+        stats.unchangedWrites = mUnchangedWrites.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+protected:
+    // policy this cache was instantiated with, calls through it are resolved at compile time
+    Derived& Policy(){
+
+        return static_cast<Derived&>(*this);
+    }
+
+    static uint16_t EvictionKeyOf(const CacheBufferType& p_Buffer){
+
+        if (p_Buffer.status == (short)BUFFER_STATUS::BUSY || p_Buffer.status == (short)BUFFER_STATUS::FREE)
+            return EvictionKeys::NOT_EVICTABLE;
+        return static_cast<uint16_t>(p_Buffer.frequency);
+    }
+
+    // dense layout: call after every store/CAS that may change status or frequency of buffer p_Index
+    void SyncEvictionKey(buffer_cache_index p_Index){
+
+        if constexpr (layout == SLOT_LAYOUT::DENSE){
+
+            mEvictionKeys.Sync(p_Index, [this, p_Index](){
+
+                return EvictionKeyOf(mFreeList[p_Index].load(std::memory_order_acquire));
+            });
+        }
+    }
+
+    /*
+     * @brief       common tail of eviction and expiry for a buffer this thread claimed (status BUSY)
+     *              # - write back p_Evicted if it is DIRTY while its key is still mapped
+     *                  so readers spin on BUSY instead of loading stale copy from file
+     *              # - drop the key from hash map, disarm its timer and release the payload
+     *              # - evicted entries (p_KeepWarm) move to the warm tier in the same map update
+     *                  so a key is never in both
+     *
+     * @return      void
+    */
+    void DropBuffer(buffer_cache_index p_Index, const CacheBufferType& p_Evicted, bool p_KeepWarm = false){
+
+        BUFFER_STATUS old_status = (BUFFER_STATUS)p_Evicted.status;
+
+        // lock free readers that found this buffer in the read index must not take what it is refilled with
+        mBufferVersions[p_Index].fetch_add(1, std::memory_order_release);
+
+        // Buffer is BUSY and owned by this thread now, mapping of its key can only be changed by us.
+        std::shared_lock lk(mHashMapMutex);
+        const bool is_mapped = IsMapped(p_Index);
+        key_type evicted_key{};
+        if (is_mapped)
+            evicted_key = mBufferKeys[p_Index];
+        lk.unlock();
+
+        if (old_status == BUFFER_STATUS::DIRTY)
+            mNumberOfDirtyBuffers.fetch_sub(1, std::memory_order_relaxed);
+
+        //check if buffer have cached data of some mem block but not yet flushed to physical file
+        std::string record;
+        bool has_record = false;
+        if (is_mapped && (old_status == BUFFER_STATUS::DIRTY || (p_KeepWarm && mWarmTier.Enabled())))
+            has_record = value_storage::Serialize(mSlabAllocator, p_Evicted.data, record);
+        if (has_record && old_status == BUFFER_STATUS::DIRTY)
+            mFileUtility.WriteItem(evicted_key, record);
+
+        if (is_mapped){
+
+            std::unique_lock ulk(mHashMapMutex);
+            mCachedMemBlocks.erase(evicted_key);
+            mReadIndex.Erase(evicted_key);
+            // clean copy now, the items file has the same value
+            if (p_KeepWarm && has_record)
+                mWarmTier.Insert(evicted_key, record);
+            mNumberOfMappedBuffers.store(mCachedMemBlocks.size(), std::memory_order_relaxed);
+        }
+        mTimerWheel.Cancel(p_Index);
+        mPrefetched[p_Index].store(false, std::memory_order_relaxed);
+
+        // readers still holding the old handle will fail their generation check
+        value_storage::Release(mSlabAllocator, p_Evicted.data);
+    }
+
+    /*
+     * @brief       drop the cached copy of p_Position without writing it back, waits out an eviction
+     *              or update of its buffer so a dirty copy being evicted is in the items file before this returns
+     *
+     * @return      true if a copy was cached
+    */
+    bool DropCachedCopy(const key_type& p_Position){
+
+        bool removed = false;
+        std::shared_lock lk(mHashMapMutex);
+        for (;;){
+
+            auto itr = mCachedMemBlocks.find(p_Position);
+            if (itr == mCachedMemBlocks.end())
+                break;
+
+            const buffer_cache_index index = itr->second;
+            std::atomic<CacheBufferType>& cache = mFreeList[index];
+            CacheBufferType buf_to_remove = cache.load(std::memory_order_acquire);
+            CacheBufferType claimed_buf;
+            claimed_buf.status = (short)BUFFER_STATUS::BUSY;
+            claimed_buf.frequency = 0;
+            if (buf_to_remove.status == (short)BUFFER_STATUS::BUSY || buf_to_remove.status == (short)BUFFER_STATUS::FREE ||
+                    !cache.compare_exchange_strong(buf_to_remove, claimed_buf)){
+
+                // being evicted or updated, look again once it settled
+                lk.unlock();
+                std::this_thread::yield();
+                lk.lock();
+                continue;
+            }
+            lk.unlock();
+            SyncEvictionKey(index);
+
+            if (buf_to_remove.status == (short)BUFFER_STATUS::DIRTY){
+
+                mNumberOfDirtyBuffers.fetch_sub(1, std::memory_order_relaxed);
+                buf_to_remove.status = (short)BUFFER_STATUS::VALID;
+            }
+            DropBuffer(index, buf_to_remove);
+            ReclaimBuffer(index);
+            removed = true;
+            break;
+        }
+        return removed;
+    }
+
+    /*
+     * @brief       write p_Value straight to the items file and invalidate the cached copy (write around)
+     *              # - the copy is dropped first so no older dirty value can be written back over this one
+     *              # - the file is written with the map exclusive, misses read the file holding it too
+     *                  so none can load the old value once the copy is gone, a miss that did in between
+     *                  is dropped again
+     *
+     * @return      void
+    */
+    void WriteAround(const key_type& p_Position, const value_type& p_Value){
+
+        std::string record;
+        value_storage::Format(p_Value, record);
+        for (;;){
+
+            DropCachedCopy(p_Position);
+            std::unique_lock ulk(mHashMapMutex);
+            if (mCachedMemBlocks.find(p_Position) != mCachedMemBlocks.end())
+                continue;
+
+            mWarmTier.Erase(p_Position);
+            // readahead that read the old value before this must not admit it
+            mWrittenAround.fetch_add(1, std::memory_order_release);
+            mFileUtility.WriteItem(p_Position, record);
+            break;
+        }
+    }
+
+    /*
+     * @brief       reclaim buffer p_Index if its timer p_Deadline is still the armed one,
+     *              buffer ends up FREE in the reclaimed list for GetNewBufferFromCache
+     *
+     * @return      true if buffer was reclaimed
+    */
+    bool ExpireBuffer(buffer_cache_index p_Index, TimerWheel::tick_type p_Deadline){
+
+        std::atomic<CacheBufferType>& cache = mFreeList[p_Index];
+        if (p_Deadline == TimerWheel::NO_DEADLINE || mTimerWheel.Deadline(p_Index) != p_Deadline)
+            return false;
+        CacheBufferType buf_to_expire = cache.load(std::memory_order_acquire);
+        // buffer might have been re-assigned between the deadline check and the load
+        if (mTimerWheel.Deadline(p_Index) != p_Deadline ||
+                buf_to_expire.status == (short)BUFFER_STATUS::BUSY || buf_to_expire.status == (short)BUFFER_STATUS::FREE)
+            return false;
+
+        CacheBufferType claimed_buf;
+        claimed_buf.status = (short)BUFFER_STATUS::BUSY;
+        claimed_buf.frequency = 0;
+        if (!cache.compare_exchange_strong(buf_to_expire, claimed_buf))
+            return false;
+        SyncEvictionKey(p_Index);
+
+        if (mExpiryRemoves){
+
+            // while the buffer is BUSY readers wait instead of loading the record, a write back holds the map shared
+            std::unique_lock ulk(mHashMapMutex);
+            if (IsMapped(p_Index)){
+
+                mFileUtility.EraseItem(mBufferKeys[p_Index]);
+                mWarmTier.Erase(mBufferKeys[p_Index]);
+            }
+            ulk.unlock();
+            if (buf_to_expire.status == (short)BUFFER_STATUS::DIRTY){
+
+                mNumberOfDirtyBuffers.fetch_sub(1, std::memory_order_relaxed);
+                buf_to_expire.status = (short)BUFFER_STATUS::VALID;
+            }
+        }
+        DropBuffer(p_Index, buf_to_expire);
+        ReclaimBuffer(p_Index);
+        return true;
+    }
+
+    /*
+     * @brief       move the entry of buffer p_From into p_To (claimed by this thread, BUSY) for a shrink,
+     *              p_From is claimed BUSY while the key is remapped so readers of it retry and find p_To,
+     *              payload, frequency, dirty state and remaining time to live go along, p_From ends up retired
+     *
+     * @return      false if p_From was taken meanwhile, p_To is left to the caller then
+    */
+    bool MoveBuffer(buffer_cache_index p_From, buffer_cache_index p_To){
+
+        std::atomic<CacheBufferType>& from = mFreeList[p_From];
+        CacheBufferType moved = from.load(std::memory_order_acquire);
+        CacheBufferType claimed_buf;
+        claimed_buf.status = (short)BUFFER_STATUS::BUSY;
+        claimed_buf.frequency = 0;
+        if (moved.status == (short)BUFFER_STATUS::BUSY || moved.status == (short)BUFFER_STATUS::FREE ||
+                !from.compare_exchange_strong(moved, claimed_buf))
+            return false;
+        SyncEvictionKey(p_From);
+        mBufferVersions[p_From].fetch_add(1, std::memory_order_release);
+
+        {
+            // hits and updates of the key hold the map shared, so they see either buffer whole
+            std::unique_lock ulk(mHashMapMutex);
+            const key_type key = mBufferKeys[p_From];
+            mFreeList[p_To].store(moved, std::memory_order_release);
+            SyncEvictionKey(p_To);
+            mCachedMemBlocks[key] = p_To;
+            mBufferKeys[p_To] = key;
+            mReadIndex.Insert(key, p_To, mBufferVersions[p_To].load(std::memory_order_relaxed));
+            mDirtySince[p_To].store(mDirtySince[p_From].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            mPrefetched[p_To].store(mPrefetched[p_From].exchange(false, std::memory_order_relaxed), std::memory_order_relaxed);
+
+            // a deadline already passed fires on the next tick
+            const TimerWheel::tick_type deadline = mTimerWheel.Deadline(p_From);
+            const TimerWheel::tick_type now = mTimerWheel.CurrentTick();
+            mTimerWheel.Cancel(p_From);
+            if (deadline != TimerWheel::NO_DEADLINE)
+                mTimerWheel.Schedule(p_To, mTimerWheel.Resolution() * (deadline > now ? deadline - now : 1));
+        }
+
+        ReclaimBuffer(p_From);
+        return true;
+    }
+
+    /*
+     * @brief       mark a buffer this thread claimed (status BUSY, already dropped) FREE
+     *              and put it on the reclaimed list for GetNewBufferFromCache unless a shrink retired it
+     *
+     * @return      void
+    */
+    void ReclaimBuffer(buffer_cache_index p_Index){
+
+        CacheBufferType free_buf;
+        free_buf.status = (short)BUFFER_STATUS::FREE;
+        free_buf.frequency = 0;
+        mFreeList[p_Index].store(free_buf, std::memory_order_release);
+        SyncEvictionKey(p_Index);
+
+        // above the target of a shrink the buffer is retired, Resize hands it out again when growing
+        std::lock_guard lk(mReclaimedBuffersGuard);
+        if (p_Index < (buffer_cache_index)mActiveBuffers.load(std::memory_order_acquire))
+            mReclaimedBuffers.push_back(p_Index);
+    }
+
+    /*
+     * @brief       account a buffer that just turned DIRTY, its age starts now
+     *              crossing the dirty ratio wakes the writeback thread
+     *
+     * @return      void
+    */
+    void MarkDirty(buffer_cache_index p_Index){
+
+        mDirtySince[p_Index].store(DirtyClock(), std::memory_order_relaxed);
+        const std::size_t dirty = mNumberOfDirtyBuffers.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (mWritebackPolicy.dirtyRatio > 0 && dirty >= DirtyLimit())
+            mWritebackTrigger.Notify(WritebackTrigger::DIRTY_RATIO);
+    }
+
+    // dirty ratio applies to the buffers in use, not to the capacity reserved for growing
+    std::size_t DirtyLimit() const{
+
+        return static_cast<std::size_t>(mWritebackPolicy.dirtyRatio * mActiveBuffers.load(std::memory_order_relaxed));
+    }
+
+    /*
+     * @brief       write back buffer p_Index if it is DIRTY and still mapped
+     *
+     * @return      true if it was written
+    */
+    bool WritebackBuffer(buffer_cache_index p_Index){
+
+        if (mFreeList[p_Index].load(std::memory_order_acquire).status != (short)BUFFER_STATUS::DIRTY)
+            return false;
+
+        // Hold the map shared so eviction can not drop the key between marking VALID and writing
+        std::shared_lock lk(mHashMapMutex);
+        return WritebackMappedBuffer(p_Index);
+    }
+
+    /*
+     * @brief       write back buffer p_Index while it is DIRTY, caller holds mHashMapMutex (shared or unique).
+     *              payload is copied before the CAS so the copy is exactly what was marked VALID, a CAS lost
+     *              to a frequency bump or an update is retried with the new contents
+     *
+     * @return      true if it was written
+    */
+    bool WritebackMappedBuffer(buffer_cache_index p_Index){
+
+        std::atomic<CacheBufferType>& cache = mFreeList[p_Index];
+        CacheBufferType temp = cache.load(std::memory_order_acquire);
+        std::string record;
+        for (;;){
+
+            if (temp.status != (short)BUFFER_STATUS::DIRTY || !IsMapped(p_Index))
+                return false;
+
+            // payload replaced by an update since the load, serialize the new one
+            if (!value_storage::Serialize(mSlabAllocator, temp.data, record)){
+
+                temp = cache.load(std::memory_order_acquire);
+                continue;
+            }
+
+            CacheBufferType temp_updated = temp;
+            temp_updated.status = (short)BUFFER_STATUS::VALID;
+            if (cache.compare_exchange_weak(temp, temp_updated))
+                break;
+        }
+
+        mNumberOfDirtyBuffers.fetch_sub(1, std::memory_order_relaxed);
+        mBuffersWritten.fetch_add(1, std::memory_order_relaxed);
+        //std::cout << "Inserting to file: " << mBufferKeys[p_Index] << ","<< record << std::endl;
+        mFileUtility.WriteItem(mBufferKeys[p_Index], record);
+        return true;
+    }
+
+    // milliseconds on the steady clock since this cache was created
+    int64_t DirtyClock() const{
+
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - mCreated).count();
+    }
+
+    /*
+     * @brief       feed an access to the stream detector, a detected stream gets its items file
+     *              range hinted to the kernel right away and queued for the readahead thread
+     *
+     * @return      void
+    */
+    void ObserveStream(const key_type& p_Position){
+
+        if constexpr (std::is_integral_v<key_type>){
+
+            PrefetchWindow window;
+            if (!mStreamDetector.Observe(static_cast<int64_t>(p_Position), window))
+                return;
+
+            mFileUtility.WillNeed(WindowKeys(window));
+            mPrefetchQueue.Push(window);
+        }
+    }
 
-            /*
-             * Its safe to get the buffer from free list because if the status was set BUSY previously
-             * No writes will be done
-            */
-            auto &updated_cache = mFreeList[least_frequently_used_buffer_index];
-            CacheBufferType updated_buf = updated_cache.load(std::memory_order_acquire);
-            CacheBufferType new_buf;
-            do{
-                new_buf.data = 0;
-                new_buf.status = (short)BUFFER_STATUS::BUSY;
-                new_buf.frequency = 0;
-            }while(!updated_cache.compare_exchange_weak(updated_buf,new_buf));
+    std::vector<key_type> WindowKeys(const PrefetchWindow& p_Window) const{
 
-            // Flush dirty cache
-            auto fl = [dirtyCacheData, this](){
+        std::vector<key_type> keys;
+        if constexpr (std::is_integral_v<key_type>){
 
-                if (dirtyCacheData.first != -1)
-                {
-                    mFileUtility.InsertDataAtIndex(dirtyCacheData);
-                }
-            };
-            std::thread t(fl);
-            t.detach();
+            keys.reserve(p_Window.count);
+            for (std::size_t i = 0; i < p_Window.count; ++i){
 
-            return least_frequently_used_buffer_index;
+                const int64_t key = p_Window.first + (static_cast<int64_t>(i) * p_Window.stride);
+                if (key < std::numeric_limits<key_type>::min() || key > std::numeric_limits<key_type>::max())
+                    break;
+                keys.push_back(static_cast<key_type>(key));
+            }
         }
+        return keys;
     }
 
     /*
-     * @brief       This Method will get the value from cache if cache miss happens
-     *              data is loaded from physical file and update the cache
+     * @brief       low priority admission of a prefetched key, it is loaded VALID with frequency
+     *              mPrefetchFrequency so LFU evicts it before anything that was actually used,
+     *              and it only replaces entries used at most once
      *
-     * @return      data at specified line p_Position
+     * @return      false once only hotter entries are left so rest of the window is dropped
     */
-    virtual const bool Get(const key_type& p_Position, value_type& p_PositionValue) {
-
-        bool cache_miss_happened = false;
-
-        std::shared_lock lk(mHashMapMutex);
-        for (;;){
-
-            auto itr = mCachedMemBlocks.find(p_Position);
-            if(itr == mCachedMemBlocks.end()){
-
-                cache_miss_happened = true;
-                lk.unlock();
+    bool AdmitPrefetched(const key_type& p_Key){
 
-                while(true){
+        {
+            std::shared_lock lk(mHashMapMutex);
+            if (mCachedMemBlocks.find(p_Key) != mCachedMemBlocks.end())
+                return true;
+        }
 
-                    buffer_cache_index new_buf_index = this->GetNewBufferFromCache();
-                    assert(new_buf_index < this->mNumberOfBuffers);
+        const std::size_t written_around = mWrittenAround.load(std::memory_order_acquire);
+        std::string record;
+        if (!mFileUtility.ReadItem(p_Key, record))
+            return true;
 
-                    std::unique_lock ulk(mHashMapMutex);
+        buffer_cache_index new_buf_index = PopReclaimedBuffer();
+        if (new_buf_index == INVALID_INDEX){
 
-                    auto &new_cache = mFreeList.at(new_buf_index);
-                    CacheBufferType new_buf = new_cache.load(std::memory_order_acquire);
-                    CacheBufferType to_update_buf;
-                    //read the value from file
-                    p_PositionValue = to_update_buf.data = mFileUtility.ReadFileAtIndex(p_Position);
-                    to_update_buf.status = (short)BUFFER_STATUS::DIRTY;
-                    to_update_buf.frequency = 1;
-                    if(!new_cache.compare_exchange_strong(new_buf,to_update_buf) == true){
+            const buffer_cache_index victim = Policy().FindVictim();
+            if (victim == INVALID_INDEX || mFreeList[victim].load(std::memory_order_acquire).frequency > mPrefetchFrequency + 1)
+                return false;
+            new_buf_index = EvictBuffer();
+        }
 
-                        //std::cout <<"buf consumed re-comute" << std::endl;
-                        ulk.unlock();
-                        std::this_thread::sleep_for(10ms);
-                        continue;
-                    }
+        value_type value;
+        value_storage::Parse(record, value);
+        CacheBufferType prefetched_buf;
+        prefetched_buf.data = value_storage::Store(mSlabAllocator, value);
+        prefetched_buf.status = (short)BUFFER_STATUS::VALID;
+        prefetched_buf.frequency = mPrefetchFrequency;
 
-                    // Update quick tracker
-                    mCachedMemBlocks[p_Position] = new_buf_index;
-                    break;
-                }
-            }else{
+        std::unique_lock ulk(mHashMapMutex);
+        if (mCachedMemBlocks.find(p_Key) != mCachedMemBlocks.end() || mWrittenAround.load(std::memory_order_acquire) != written_around){
 
-                // Atomic read no need explicit lock;
-                if (!this->GetCachedValue(itr->second, p_PositionValue))
-                    continue;
-            }
-            break;
+            ulk.unlock();
+            value_storage::Release(mSlabAllocator, prefetched_buf.data);
+            ReclaimBuffer(new_buf_index);
+            return true;
         }
 
-        return cache_miss_happened;
+        // buffer is BUSY and owned by this thread
+        mFreeList[new_buf_index].store(prefetched_buf, std::memory_order_release);
+        SyncEvictionKey(new_buf_index);
+        mCachedMemBlocks[p_Key] = new_buf_index;
+        mBufferKeys[new_buf_index] = p_Key;
+        mReadIndex.Insert(p_Key, new_buf_index, mBufferVersions[new_buf_index].load(std::memory_order_relaxed));
+        mWarmTier.Erase(p_Key);
+        mNumberOfMappedBuffers.store(mCachedMemBlocks.size(), std::memory_order_relaxed);
+        mTimerWheel.Schedule(new_buf_index, mDefaultTimeToLive);
+        mPrefetched[new_buf_index].store(true, std::memory_order_relaxed);
+        mPrefetchAdmitted.fetch_add(1, std::memory_order_relaxed);
+        return true;
     }
 
     /*
-     * @brief       This Method will put the value to the cache and update frequency
-     *              if cache miss happens data is loaded from physical file and cache is updated
+     * @brief       evict least frequently used entries until memory in use fits the budget again
      *
      * @return      void
     */
-    virtual void Put(const key_type& p_Position, const value_type& p_Value){
+    void EnforceMemoryBudget(){
 
-        std::shared_lock lk(mHashMapMutex);
-        auto itr = mCachedMemBlocks.find(p_Position);
-        if(itr == mCachedMemBlocks.end()){
+        if (mMemoryBudget == 0)
+            return;
 
-            lk.unlock();
+        // always keep the most recent entry even if its payload alone is over the budget
+        while (MemoryInUse() > mMemoryBudget && mNumberOfMappedBuffers.load(std::memory_order_relaxed) > 1){
 
-            while(true){
+            ReclaimBuffer(EvictBuffer());
+        }
+    }
 
-                buffer_cache_index new_buf_index = this->GetNewBufferFromCache();
-                assert(new_buf_index < this->mNumberOfBuffers);
+    /*
+     * @brief       bytes used by buffers, index and reserved slab pages, what the memory budget is checked against
+     *              a page partly used counts whole, it is given back once eviction empties it
+     *
+     * @return      bytes in use
+    */
+    std::size_t MemoryInUse() const{
 
-                std::unique_lock ulk(mHashMapMutex);
+        return (mNumberOfBuffers * mFixedBytesPerBuffer) +
+                (mNumberOfMappedBuffers.load(std::memory_order_relaxed) * mIndexBytesPerEntry) +
+                mSlabAllocator.ReservedBytes();
+    }
 
-                auto &new_cache = mFreeList.at(new_buf_index);
-                CacheBufferType new_buf = new_cache.load(std::memory_order_acquire);
-                CacheBufferType to_update_buf;
-                to_update_buf.data = p_Value;
-                to_update_buf.status = (short)BUFFER_STATUS::DIRTY;
-                to_update_buf.frequency = 1;
-                if(!new_cache.compare_exchange_strong(new_buf,to_update_buf) == true){
+    /*
+     * @brief       claim a buffer from the reclaimed list, FREE -> BUSY
+     *
+     * @return      buffer index or INVALID_INDEX if there is none
+    */
+    buffer_cache_index PopReclaimedBuffer(){
 
-                    //std::cout <<"buf consumed re-comute" << std::endl;
-                    ulk.unlock();
-                    std::this_thread::sleep_for(10ms);
-                    continue;
-                }
+        for(;;){
 
-                // Update quick tracker
-                mCachedMemBlocks[p_Position] = new_buf_index;
-                break;
+            buffer_cache_index index;
+            {
+                std::lock_guard lk(mReclaimedBuffersGuard);
+                if (mReclaimedBuffers.empty())
+                    return INVALID_INDEX;
+                index = mReclaimedBuffers.back();
+                mReclaimedBuffers.pop_back();
             }
-        }else{
+            if (index >= (buffer_cache_index)mActiveBuffers.load(std::memory_order_acquire))
+                continue;
 
-            // Atomic update no need explicit lock;
-            this->SetCachedValue((*itr).second, p_Value);
+            // eviction algorithm may have picked the FREE buffer meanwhile
+            std::atomic<CacheBufferType>& cache = mFreeList[index];
+            CacheBufferType free_buf = cache.load(std::memory_order_acquire);
+            if (free_buf.status != (short)BUFFER_STATUS::FREE)
+                continue;
+            CacheBufferType claimed_buf;
+            claimed_buf.status = (short)BUFFER_STATUS::BUSY;
+            claimed_buf.frequency = 0;
+            if (cache.compare_exchange_strong(free_buf, claimed_buf))
+                return index;
         }
     }
 
     /*
-     * @brief       This Method will periodically flush the dirty cache to storage
+     * @brief       Get hit without mHashMapMutex, the read index is searched inside an epoch so the node
+     *              found can not be freed meanwhile, the buffer is loaded (acquire) before its version is
+     *              checked so a buffer evicted and refilled for another key after the lookup is detected
      *
-     * @return      void
+     * @return      true if p_Value was read, false to take the locked path (miss, BUSY, expired, no epoch slot)
     */
-    void Flush(){
+    bool GetLockFree(const key_type& p_Position, value_type& p_Value, bool& p_StreamAccess){
 
-        for (const auto& item : mFreeList | boost::adaptors::indexed(0)){
+        EpochDomain::Guard guard(EpochDomain::Global());
+        if (!guard)
+            return false;
 
-            CacheBufferType temp = item.value().load(std::memory_order_acquire);
-            CacheBufferType temp_updated = temp;
-            if(temp.status == (short)BUFFER_STATUS::DIRTY){
+        buffer_cache_index index;
+        uint32_t version;
+        if (!mReadIndex.Find(p_Position, index, version) || mTimerWheel.IsExpired(index))
+            return false;
 
-                temp.status = (short)BUFFER_STATUS::VALID;
-                if(item.value().compare_exchange_strong(temp_updated,temp)){
+        // on failure p_Value is overwritten by the locked path anyway, which also counts the hit
+        if (!Policy().ReadCachedValue(index, p_Value) || mBufferVersions[index].load(std::memory_order_acquire) != version)
+            return false;
+        Policy().RecordHit(index);
+
+        // first use of a prefetched key keeps its stream window sliding
+        std::atomic<bool>& prefetched = mPrefetched[index];
+        if (prefetched.load(std::memory_order_relaxed) && prefetched.exchange(false, std::memory_order_relaxed)){
+
+            mPrefetchUsed.fetch_add(1, std::memory_order_relaxed);
+            p_StreamAccess = true;
+        }
+        return true;
+    }
 
-                    std::lock_guard lk(mHashMapMutex);
-                    auto itr = std::find_if(mCachedMemBlocks.begin(), mCachedMemBlocks.end(),
-                                            [item](auto &i){
+    /*
+     * @brief       consistent copy of the entry in buffer p_Index, caller must hold mHashMapMutex shared
+     *              so the mapping (and with it the key) of a buffer that is neither BUSY nor FREE can not change
+     *
+     * @return      false if the buffer holds no entry
+    */
+    bool CopyEntry(buffer_cache_index p_Index, CacheEntry<key_type, value_type>& p_Entry){
 
-                        return(i.second == item.index());
-                    });
-                    if (itr != mCachedMemBlocks.end()){
+        for (;;){
 
-                        //std::cout << "Inserting to file: " << (*itr).first << ","<< temp.data << std::endl;
-                        mFileUtility.InsertDataAtIndex(std::make_pair((*itr).first, std::to_string(temp.data)));
-                    }else{
+            CacheBufferType temp = mFreeList[p_Index].load(std::memory_order_acquire);
+            if (temp.status == (short)BUFFER_STATUS::FREE || temp.status == (short)BUFFER_STATUS::BUSY || !IsMapped(p_Index))
+                return false;
 
-                        //std::cout << "Buf taken up phew!!";
-                    }
-                }else{
+            // payload released by an update after the load, take the new version
+            if (!value_storage::Load(mSlabAllocator, temp.data, p_Entry.value))
+                continue;
 
-                    //std::cout << "Buf taken up phew!!";
-                }
-            }
+            p_Entry.key = mBufferKeys[p_Index];
+            p_Entry.frequency = temp.frequency;
+            p_Entry.dirty = (temp.status == (short)BUFFER_STATUS::DIRTY);
+            return true;
         }
     }
 
+    // caller must hold mHashMapMutex
+    bool IsMapped(buffer_cache_index p_Index) const{
+
+        auto itr = mCachedMemBlocks.find(mBufferKeys[p_Index]);
+        return (itr != mCachedMemBlocks.end() && itr->second == p_Index);
+    }
+
 protected:
+    // free list slot, reverse index key, version, read index buckets and timer wheel entry are allocated for every buffer up front
+    static constexpr std::size_t mFixedBytesPerBuffer = sizeof(std::atomic<CacheBufferType>) + sizeof(key_type) +
+                                                        (layout == SLOT_LAYOUT::DENSE ? sizeof(uint16_t) : 0) +
+                                                        sizeof(std::atomic<uint32_t>) + ReadIndex<key_type>::mBucketBytesPerEntry +
+                                                        (3 * sizeof(int)) + sizeof(std::atomic<TimerWheel::tick_type>);
+    // hash map node (next pointer, cached hash, key/value pair), its bucket pointer and the read index node
+    static constexpr std::size_t mIndexBytesPerEntry = (2 * sizeof(void*)) + sizeof(std::size_t) +
+                                                        sizeof(std::pair<const key_type, buffer_cache_index>) + ReadIndex<key_type>::mNodeBytes;
+    // legacy line numbered file only fits short keys with numeric values
+    static constexpr RECORD_FORMAT mRecordFormat = (KeyTraits<Key>::line_addressable && value_storage::fits_fixed_width) ?
+                                                    RECORD_FORMAT::FIXED_WIDTH : RECORD_FORMAT::VARIABLE_LENGTH;
     const buffer_cache_index INVALID_INDEX = -1;
-    kernel_parameter_cache_size mNumberOfBuffers;                        //buffer cache size - NBUF
-    freebuffer_list_type mFreeList{mNumberOfBuffers};                    //cache buffers
+    kernel_parameter_cache_size mNumberOfBuffers;                        //buffer cache size - NBUF, reserved ones included
+    std::atomic<kernel_parameter_cache_size> mActiveBuffers;             //buffers below this are used, target of Resize
+    std::mutex mResizeGuard;                                             //one Resize/RelocateBuffers at a time
+    HugePageStats mHugePages;                                            //pages obtained for free list and reverse index
+    freebuffer_list_type mFreeList;                                      //cache buffers
+    EvictionKeys mEvictionKeys;                                          //dense layout only, what the victim scan reads
+    SlabAllocator mSlabAllocator;                                        //payloads of variable length values
     FileUtility mFileUtility;
-    HashMapStrorage<int, int> mCachedMemBlocks;                          //quick tracker
+    HashMapStrorage<Key, buffer_cache_index> mCachedMemBlocks;           //quick tracker
+    buffer_key_list_type mBufferKeys;                                    //reverse of quick tracker, guarded by mHashMapMutex
+    ReadIndex<key_type> mReadIndex;                                      //quick tracker for lock free hits, written under mHashMapMutex
+    WarmTier<key_type> mWarmTier;                                        //evicted entries packed, updated under mHashMapMutex
+    SingleFlight<key_type> mInFlightMisses;                              //Get misses loading right now
+    PerfCounters* mPerfCounters = nullptr;                               //eviction/flush counters, null off
+    std::atomic<std::size_t> mMissLoads{0};
     std::shared_mutex mHashMapMutex;
-    std::function<buffer_cache_index()> mEvictionAlgo;
+    TimerWheel mTimerWheel;                                              //per buffer expiry
+    time_to_live_type mDefaultTimeToLive{0};                             //0 never expires
+    bool mExpiryRemoves = false;                                         //expiry erases the record instead of writing back
+    std::vector<buffer_cache_index> mReclaimedBuffers;                   //FREE buffers ready to use
+    std::mutex mReclaimedBuffersGuard;
+    std::size_t mMemoryBudget = 0;                                       //bytes, 0 count buffers only
+    static constexpr std::size_t mBudgetBytesPerSlabPage = 32;           //slab page size is budget / this
+    std::atomic<std::size_t> mNumberOfMappedBuffers{0};
+    static constexpr short mPrefetchFrequency = 0;                       //demand loads start at 1
+    StreamDetector mStreamDetector;
+    PrefetchQueue mPrefetchQueue;
+    std::unique_ptr<std::atomic<bool>[]> mPrefetched;                    //loaded by readahead and not used yet
+    std::atomic<std::size_t> mPrefetchAdmitted{0};
+    std::atomic<std::size_t> mPrefetchUsed{0};
+    static constexpr std::size_t mCleanAheadBatch = 8;                  //written ahead after a dirty eviction
+    static constexpr std::size_t mSnapshotBatch = 256;                  //buffers copied per shared hold of the map
+    const std::chrono::steady_clock::time_point mCreated = std::chrono::steady_clock::now();
+    std::unique_ptr<std::atomic<int64_t>[]> mDirtySince;                 //DirtyClock when buffer turned DIRTY
+    std::unique_ptr<std::atomic<uint32_t>[]> mBufferVersions;            //bumped each time a buffer loses its key
+    std::atomic<std::size_t> mNumberOfDirtyBuffers{0};
+    WritebackPolicy mWritebackPolicy;
+    std::atomic<WRITE_MODE> mWriteMode{WRITE_MODE::WRITE_BACK};          //read by every Put, may change at run time
+    WritebackTrigger mWritebackTrigger;
+    WritebackRateLimiter mWritebackRateLimiter;
+    std::chrono::steady_clock::time_point mLastWritebackScan = std::chrono::steady_clock::now();
+    std::atomic<std::size_t> mBuffersWritten{0};
+    std::atomic<std::size_t> mWrittenThrough{0};
+    std::atomic<std::size_t> mWrittenAround{0};                          //also the generation readahead checks
+    std::atomic<std::size_t> mDirtyEvictions{0};
+    std::atomic<std::size_t> mCleanEvictions{0};
+    std::atomic<std::size_t> mCleanLoads{0};
+    std::atomic<std::size_t> mUnchangedWrites{0};
 };
 
-template<typename Key, typename Value, template<class, class> class HashMapStrorage=std::unordered_map>
-class LFUImplementation : public ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>
+template<typename Key, typename Value, template<class, class> class HashMapStrorage=std::unordered_map, SLOT_LAYOUT layout = SLOT_LAYOUT::PADDED>
+class LFUImplementation final : public ICacheInterfaceImp<ALGO::LFU, LFUImplementation<Key, Value, HashMapStrorage, layout>, Key, Value, HashMapStrorage, layout>
 {
+    using base_type = ICacheInterfaceImp<ALGO::LFU, LFUImplementation<Key, Value, HashMapStrorage, layout>, Key, Value, HashMapStrorage, layout>;
     // Make dependent names for derived class
-    using value_type = typename ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::value_type;
-    using key_type = typename ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::key_type;
-    using CacheBufferType = typename ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::CacheBufferType;
-    using buffer_cache_index = typename ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::buffer_cache_index;
-    using BUFFER_STATUS = typename ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::BUFFER_STATUS;
-    using ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::mFreeList;
-    using ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::INVALID_INDEX;
-    using ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::mFileUtility;
-    using ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::mEvictionAlgo;
+    using value_type = typename base_type::value_type;
+    using key_type = typename base_type::key_type;
+    using value_storage = typename base_type::value_storage;
+    using stored_value_type = typename base_type::stored_value_type;
+    using CacheBufferType = typename base_type::CacheBufferType;
+    using buffer_cache_index = typename base_type::buffer_cache_index;
+    using BUFFER_STATUS = typename base_type::BUFFER_STATUS;
+    using base_type::mFreeList;
+    using base_type::INVALID_INDEX;
+    using base_type::mFileUtility;
+    using base_type::mSlabAllocator;
+    using base_type::mEvictionKeys;
 public:
 
-    explicit LFUImplementation(int max_size, const std::string& p_FileName)
-        :ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>(max_size, p_FileName){
+    explicit LFUImplementation(std::size_t max_size, const std::string& p_FileName, HUGE_PAGES p_HugePages = HUGE_PAGES::OFF,
+                               std::size_t p_Capacity = 0)
+        :base_type(max_size, p_FileName, p_HugePages, p_Capacity){}
 
-        ICacheInterfaceImp<ALGO::LFU, Key, Value, HashMapStrorage>::mEvictionAlgo = [this]()->buffer_cache_index{
+    /*
+     * @brief       eviction algorithm, least frequently used buffer that is neither BUSY nor FREE
+     *
+     * @return      buffer free list index of the victim, INVALID_INDEX if every buffer is BUSY
+    */
+    buffer_cache_index FindVictim(){
 
-                // When Get/Put happening do not judge free list
-                buffer_cache_index least_frequently_used_buffer_index = INVALID_INDEX;
-                short least_count = std::numeric_limits<short>::max();
-                for (const auto& item : mFreeList | boost::adaptors::indexed(0)){
+        // judge on recent hits as well
+        DrainReadBuffers();
 
-                    CacheBufferType temp = item.value().load(std::memory_order_acquire);
-                    //some other thread must be trying to acquire the same buffer
-                    if(temp.status != (short)BUFFER_STATUS::BUSY){
+        // dense layout scans 2 byte keys with SIMD instead of loading every buffer
+        if constexpr (layout == SLOT_LAYOUT::DENSE){
 
-                        least_count = std::min(least_count,temp.frequency);
-                        if(least_count == temp.frequency){
+            const int victim = mEvictionKeys.FindMinimum();
+            return (victim < 0 ? INVALID_INDEX : (buffer_cache_index)victim);
+        }
 
-                            least_frequently_used_buffer_index = (buffer_cache_index)item.index();
-                        }
-                    }
+        // When Get/Put happening do not judge free list, first index on ties like the dense scan
+        buffer_cache_index least_frequently_used_buffer_index = INVALID_INDEX;
+        short least_count = std::numeric_limits<short>::max();
+        for (const auto& item : mFreeList | boost::adaptors::indexed(0)){
+
+            CacheBufferType temp = item.value().load(std::memory_order_acquire);
+            //some other thread must be trying to acquire the same buffer, FREE ones are on the reclaimed list
+            if(temp.status != (short)BUFFER_STATUS::BUSY && temp.status != (short)BUFFER_STATUS::FREE){
+
+                if(temp.frequency < least_count || least_frequently_used_buffer_index == INVALID_INDEX){
+
+                    least_count = temp.frequency;
+                    least_frequently_used_buffer_index = (buffer_cache_index)item.index();
                 }
+            }
+        }
 
-                return least_frequently_used_buffer_index;
-        };
+        return least_frequently_used_buffer_index;
     }
 
     /*
      * @brief       this method will return value stored in buffer cache
-     *              if the buffer has NOT been populated yet return false
+     *              if the buffer has NOT been populated yet or is being evicted return false
+     *              hit is only recorded in the read buffer, frequency is bumped when it gets drained
      *
      * @return      true if data is valid false otherwise
      *
@@ -350,68 +1555,185 @@ public:
     */
     bool GetCachedValue(buffer_cache_index p_Index, value_type& p_Value){
 
+        if (!ReadCachedValue(p_Index, p_Value))
+            return false;
+
+        RecordHit(p_Index);
+        return true;
+    }
+
+    /*
+     * @brief       GetCachedValue without recording the hit, for readers that still have to validate the copy
+     *
+     * @return      true if data is valid false otherwise
+    */
+    bool ReadCachedValue(buffer_cache_index p_Index, value_type& p_Value){
+
         assert(p_Index < this->mNumberOfBuffers);
-        bool ret_val;
-        auto &old_val = mFreeList.at(p_Index);
-        CacheBufferType temp = old_val.load(std::memory_order_acquire);
-        //if status is free value in it must be out-dated
-        if(temp.status == (short)BUFFER_STATUS::FREE){
+        CacheBufferType temp = mFreeList.at(p_Index).load(std::memory_order_acquire);
 
-            ret_val = false;
-        }else{
+        //if status is free/busy value in it must be out-dated
+        if(temp.status == (short)BUFFER_STATUS::FREE || temp.status == (short)BUFFER_STATUS::BUSY)
+            return false;
+
+        // payload of variable length values may get released after the load, Load detects it
+        return value_storage::Load(mSlabAllocator, temp.data, p_Value);
+    }
+
+    // buffer the hit of a validated read, frequency is bumped when the read buffer gets drained
+    void RecordHit(buffer_cache_index p_Index){
+
+        if (mReadBuffer.Record(p_Index))
+            DrainReadBuffers();
+    }
+
+    /*
+     * @brief       apply buffered hits to the frequencies, run by maintenance (background thread,
+     *              eviction scan) or by the reader that found its ring full
+     *              an index reused for another key meanwhile gets the hit, buffer is lossy anyway
+     *
+     * @return      number of hits applied
+    */
+    std::size_t DrainReadBuffers(){
+
+        return mReadBuffer.Drain([this](int32_t p_Index){
 
+            auto &old_val = mFreeList[p_Index];
+            CacheBufferType temp = old_val.load(std::memory_order_acquire);
             CacheBufferType new_buf;
             do{
 
+                if(temp.status == (short)BUFFER_STATUS::FREE || temp.status == (short)BUFFER_STATUS::BUSY)
+                    return;
+
                 new_buf = temp;
-                new_buf.frequency++;
+                if (new_buf.frequency < std::numeric_limits<short>::max())
+                    new_buf.frequency++;
             }while(!old_val.compare_exchange_weak(temp,new_buf));
+            this->SyncEvictionKey(p_Index);
+        });
+    }
 
-            p_Value = temp.data;
-            ret_val = true;
-        }
+    /*
+     * @brief       halve every frequency so once hot keys that are not used any more become
+     *              evictable again, run by the background thread every decay period
+     *              each buffer is aged with its own CAS, readers and writers never wait on a pass
+     *
+     * @return      number of buffers aged
+    */
+    std::size_t AgeFrequencies(){
+
+        // hits recorded before this pass belong to the old period
+        DrainReadBuffers();
+
+        std::size_t aged = 0;
+        for (buffer_cache_index index = 0; index < (buffer_cache_index)mFreeList.size(); ++index){
+
+            auto& cache = mFreeList[index];
+            CacheBufferType temp = cache.load(std::memory_order_acquire);
+            bool halved = false;
+            for (;;){
+
+                if(temp.status == (short)BUFFER_STATUS::FREE || temp.status == (short)BUFFER_STATUS::BUSY || temp.frequency == 0)
+                    break;
+
+                CacheBufferType new_buf = temp;
+                new_buf.frequency >>= 1;
+                if (cache.compare_exchange_weak(temp,new_buf)){
+
+                    halved = true;
+                    break;
+                }
+            }
+
+            if (halved){
 
-        return ret_val;
+                this->SyncEvictionKey(index);
+                aged++;
+            }
+        }
+        return aged;
     }
 
     /*
      * @brief       this method will update the cache buffer with updated value
      *
-     * @return      void
+     * @return      false if the buffer is being evicted and caller must retry
      *
      * @pram        p_Index is index in free list to query, p_Value is value to set
     */
-    void SetCachedValue(buffer_cache_index p_Index,const value_type& p_Value){
+    bool SetCachedValue(buffer_cache_index p_Index,const value_type& p_Value){
 
         assert(p_Index < this->mNumberOfBuffers);
         auto &old_val = mFreeList.at(p_Index);
         CacheBufferType temp = old_val.load(std::memory_order_acquire);
+        stored_value_type new_data{};
+        bool stored = false;
+        bool unchanged = false;
+        CacheBufferType new_buf;
+        do{
+
+            // if BUSY cache is waiting to be over-written and key is about to be dropped from hash map.
+            if(temp.status == (short)BUFFER_STATUS::BUSY || temp.status == (short)BUFFER_STATUS::FREE){
+
+                if (stored)
+                    value_storage::Release(mSlabAllocator, new_data);
+                return false;
+            }
 
-        // if BUSY cache is waiting to be over-written also stale data was flushed to file.
-        if(temp.status != (short)BUFFER_STATUS::BUSY){
+            new_buf = temp;
+            if (new_buf.frequency < std::numeric_limits<short>::max())
+                new_buf.frequency++;
 
-            CacheBufferType new_buf;
-            do{
+            // same value only counts as an access, a VALID buffer stays clean
+            unchanged = value_storage::Equals(mSlabAllocator, temp.data, p_Value);
+            if (!unchanged){
 
-                new_buf = temp;
-                new_buf.data = p_Value;
-                new_buf.frequency++;
+                if (!stored){
+
+                    new_data = value_storage::Store(mSlabAllocator, p_Value);
+                    stored = true;
+                }
+                new_buf.data = new_data;
                 new_buf.status = (short)BUFFER_STATUS::DIRTY;
-            }while(!old_val.compare_exchange_weak(temp,new_buf));
+            }
+        }while(!old_val.compare_exchange_weak(temp,new_buf));
+        this->SyncEvictionKey(p_Index);
+
+        if (unchanged){
+
+            if (stored)
+                value_storage::Release(mSlabAllocator, new_data);
+            this->mUnchangedWrites.fetch_add(1, std::memory_order_relaxed);
+            return true;
         }
+        if (temp.status != (short)BUFFER_STATUS::DIRTY)
+            this->MarkDirty(p_Index);
+        value_storage::Release(mSlabAllocator, temp.data);
+        return true;
     }
 
 public:
 
 
     static constexpr auto mCacheBufType = ALGO::LFU;
+
+private:
+    ReadBuffer mReadBuffer;                                              //hits not yet applied to frequency
 };
 
-template<typename Key, typename Value, template<class, class> class HashMapStrorage=std::unordered_map>
-class CacheManager : public std::enable_shared_from_this<CacheManager<Key, Value, HashMapStrorage>>
+/*
+ * Policy is the cache implementation the manager drives:
+ *  # - ICacheInterface (default) picks the implementation from cache.stratergy at run time, every call is virtual
+ *  # - a concrete (final) implementation e.g LFUImplementation binds it at compile time so the Get/Put
+ *      hit path is devirtualized and can be inlined, DispatchCacheManager selects it once from config
+*/
+template<typename Key, typename Value, template<class, class> class HashMapStrorage=std::unordered_map,
+         typename Policy = ICacheInterface<Key, Value>>
+class CacheManager : public std::enable_shared_from_this<CacheManager<Key, Value, HashMapStrorage, Policy>>
 {
-    using cache_impl_type = std::unique_ptr<ICacheInterface<Key, Value>>;
-    using self_type = CacheManager<Key, Value, HashMapStrorage>;
+    using cache_impl_type = std::unique_ptr<Policy>;
+    using self_type = CacheManager<Key, Value, HashMapStrorage, Policy>;
     using self_type_ptr = std::shared_ptr<self_type>;
     using kernel_parameter_time_seconds = std::chrono::seconds;
 
@@ -420,9 +1742,14 @@ public:
     using value_type = Value;
 
     CacheManager(const cache_config& p_Config) noexcept
-        :mCacheConfig(p_Config){
+        :mCacheConfig(p_Config),
+          mThreadPlacement(CpuTopology(), ThreadPlacement::ParsePolicy(p_Config.data().thread_placement),
+                           CpuTopology::ParseCpuList(p_Config.data().reader_cpus), CpuTopology::ParseCpuList(p_Config.data().writer_cpus)){
 
         mCacheTimeOut = std::chrono::seconds(mCacheConfig.data().cache_timeout);
+        mDelayedWriteTimeout = std::chrono::seconds(mCacheConfig.data().delayed_write_timeout);
+        mDefaultTimeToLive = std::chrono::seconds(mCacheConfig.data().default_ttl);
+        mFrequencyDecayPeriod = std::chrono::seconds(mCacheConfig.data().frequency_decay_period);
         ALGO s = (mCacheConfig.data().stratergy == 0 ? ALGO::LFU : ALGO::LFU);
         try{
 
@@ -439,10 +1766,16 @@ public:
     ~CacheManager(){
 
         /*
-         * Exit the thread flusing cache to file
+         * Exit the thread flusing cache to file, it wakes up every timer tick so joining is quick
          * memory mapped file will be unmapped once FileUtility object gets deleted
         */
         mDone.store(true, std::memory_order_release);
+        if (mCacheInvalidatorThread.joinable())
+            mCacheInvalidatorThread.join();
+        if (mWritebackThread.joinable())
+            mWritebackThread.join();
+        if (mReadaheadThread.joinable())
+            mReadaheadThread.join();
     }
 
     operator bool(){
@@ -458,12 +1791,132 @@ public:
 
     const bool Get(const Key& p_Key, Value& p_Value){
 
+        PerfCounters::Measurement measurement(mPerfCounters.get(), PERF_OPERATION::GET);
+        if (mProfiler)
+            mProfiler->Access(p_Key);
         return mImplementor->Get(p_Key, p_Value);
     }
 
     void Put(const Key& p_Key, const Value& p_Value){
 
-        mImplementor->Put(p_Key, p_Value);
+        PerfCounters::Measurement measurement(mPerfCounters.get(), PERF_OPERATION::PUT);
+        if (mProfiler)
+            mProfiler->Access(p_Key);
+        mImplementor->Put(p_Key, p_Value, mDefaultTimeToLive);
+    }
+
+    void Put(const Key& p_Key, const Value& p_Value, std::chrono::milliseconds p_TimeToLive){
+
+        PerfCounters::Measurement measurement(mPerfCounters.get(), PERF_OPERATION::PUT);
+        if (mProfiler)
+            mProfiler->Access(p_Key);
+        mImplementor->Put(p_Key, p_Value, p_TimeToLive);
+    }
+
+    bool Lookup(const Key& p_Key, Value& p_Value){
+
+        if (mProfiler)
+            mProfiler->Access(p_Key);
+        return mImplementor->Lookup(p_Key, p_Value);
+    }
+
+    bool Remove(const Key& p_Key){
+
+        return mImplementor->Remove(p_Key);
+    }
+
+    // writes every dirty buffer to the items file now instead of waiting for the writeback thread
+    void Flush(){
+
+        mImplementor->Flush();
+    }
+
+    void SetExpiryRemoves(bool p_Remove){
+
+        mImplementor->SetExpiryRemoves(p_Remove);
+    }
+
+    CacheMemoryUsage MemoryUsage() const{
+
+        return mImplementor->MemoryUsage();
+    }
+
+    WritebackStats WritebackStatistics() const{
+
+        return mImplementor->WritebackStatistics();
+    }
+
+    WarmTierStats WarmTierStatistics() const{
+
+        return mImplementor->WarmTierStatistics();
+    }
+
+    MissStats MissStatistics() const{
+
+        return mImplementor->MissStatistics();
+    }
+
+    /*
+     * @brief       hardware counters of Get/Put/eviction/Flush since start with cache.perf_counters set,
+     *              where perf_event_open is refused (containers) only wall time is there
+     *
+     * @return      totals per operation, all zero when measuring is off
+    */
+    PerfStats PerfStatistics() const{
+
+        return mPerfCounters ? mPerfCounters->Statistics() : PerfStats{};
+    }
+
+    /*
+     * @brief       change capacity without restart, up to cache.max_size_of_cache buffers
+     *              growing takes effect right away, shrinking evicts the coldest entries a batch
+     *              per timer tick on the background thread
+     *
+     * @return      false if p_NumberOfBuffers is out of the reserved range (or the cache can not resize)
+    */
+    bool Resize(std::size_t p_NumberOfBuffers){
+
+        return mImplementor->Resize(p_NumberOfBuffers);
+    }
+
+    std::size_t NumberOfBuffers() const{
+
+        return mImplementor->NumberOfBuffers();
+    }
+
+    /*
+     * @brief       estimated hit ratio from 0.25x to 4x of the current number of buffers, profiled
+     *              on the cache.mrc_sample_rate share of keys seen by Get/Put/Lookup
+     *
+     * @return      curve, no points when profiling is off
+    */
+    MissRatioCurve MissRatioStatistics() const{
+
+        if (!mProfiler)
+            return MissRatioCurve{};
+        return mProfiler->Curve(NumberOfBuffers());
+    }
+
+    /*
+     * @brief       visit every resident entry without pausing Get/Put, see ICacheInterfaceImp::ForEachEntry
+     *
+     * @return      number of entries visited
+    */
+    std::size_t ForEachEntry(const std::function<bool(const CacheEntry<Key, Value>&)>& p_Visitor){
+
+        return mImplementor->ForEachEntry(p_Visitor);
+    }
+
+    // resident set for warmup, debugging and metrics, consistent per entry but not across entries
+    std::vector<CacheEntry<Key, Value>> Snapshot(){
+
+        std::vector<CacheEntry<Key, Value>> entries;
+        ForEachEntry([&entries](const CacheEntry<Key, Value>& p_Entry){
+
+            entries.push_back(p_Entry);
+            return true;
+        });
+        return entries;
     }
 
     const cache_config& getConfig(){
@@ -471,40 +1924,173 @@ public:
         return mCacheConfig;
     }
 
+    ThreadPlacement& Placement(){
+
+        return mThreadPlacement;
+    }
+
 private:
-    void setStratergy(ALGO p_Policy, int p_MaxSize){
+    void setStratergy(ALGO p_Policy, std::size_t p_MaxSize){
+
+        const std::size_t memory_budget = mCacheConfig.data().memory_budget;
+        const HUGE_PAGES huge_pages = static_cast<HUGE_PAGES>(mCacheConfig.data().huge_pages);
+        // buffers reserved so Resize can grow without restart
+        const std::size_t max_size = mCacheConfig.data().max_cache_size;
+        if constexpr (!std::is_abstract_v<Policy>){
+
+            // bound at compile time, configured stratergy was dispatched before constructing us
+            assert(p_Policy == Policy::mCacheBufType);
+            if (memory_budget)
+                p_MaxSize = Policy::BuffersForMemoryBudget(memory_budget);
+            mImplementor.reset(new Policy(p_MaxSize, mCacheConfig.data().items_file_name, huge_pages, std::max(p_MaxSize, max_size)));
+        }else{
 
-        switch(p_Policy){
+            switch(p_Policy){
 
-            case ALGO::LFU:{
+                case ALGO::LFU:{
 
-                mImplementor.reset(new LFUImplementation<Key, Value, HashMapStrorage>(p_MaxSize, mCacheConfig.data().items_file_name));
-            }
-            break;
-            default:{
-                assert(false);
+                    using implementation_type = LFUImplementation<Key, Value, HashMapStrorage>;
+                    using dense_implementation_type = LFUImplementation<Key, Value, HashMapStrorage, SLOT_LAYOUT::DENSE>;
+                    const bool dense = (static_cast<SLOT_LAYOUT>(mCacheConfig.data().slot_layout) == SLOT_LAYOUT::DENSE);
+                    // with a byte budget the number of buffers follows from the budget
+                    if (memory_budget){
+
+                        p_MaxSize = dense ? dense_implementation_type::BuffersForMemoryBudget(memory_budget) :
+                                            implementation_type::BuffersForMemoryBudget(memory_budget);
+                    }
+#ifdef USING_BOOST_IPC
+                    if constexpr (KeyTraits<Key>::line_addressable && ValueStorage<Value>::fits_fixed_width){
+
+                        if (!mCacheConfig.data().shared_memory_name.empty()){
+
+                            mImplementor.reset(new SharedMemoryLFUImplementation<Key, Value>(p_MaxSize, mCacheConfig.data().items_file_name,
+                                                                                             mCacheConfig.data().shared_memory_name));
+                            break;
+                        }
+                    }
+#endif
+                    if (dense)
+                        mImplementor.reset(new dense_implementation_type(p_MaxSize, mCacheConfig.data().items_file_name, huge_pages, std::max(p_MaxSize, max_size)));
+                    else
+                        mImplementor.reset(new implementation_type(p_MaxSize, mCacheConfig.data().items_file_name, huge_pages, std::max(p_MaxSize, max_size)));
+                }
+                break;
+                default:{
+                    assert(false);
+                }
             }
         }
 
+        mImplementor->SetDefaultTimeToLive(mDefaultTimeToLive);
+        mImplementor->SetMemoryBudget(memory_budget);
+        mImplementor->SetWarmTierBudget(mCacheConfig.data().warm_tier_budget);
+        if (mCacheConfig.data().trace_events)
+            EventTracer::Instance().Enable(true);
+        if (mCacheConfig.data().perf_counters){
+
+            mPerfCounters.reset(new PerfCounters());
+            mImplementor->SetPerfCounters(mPerfCounters.get());
+        }
+        if (mCacheConfig.data().mrc_sample_rate > 0)
+            mProfiler.reset(new ShardsProfiler<Key>(std::max(mImplementor->NumberOfBuffers(), max_size), mCacheConfig.data().mrc_sample_rate));
+        mImplementor->SetReadahead(mCacheConfig.data().readahead);
+        WritebackPolicy writeback_policy;
+        writeback_policy.interval = mCacheTimeOut;
+        writeback_policy.delayedWriteAge = mDelayedWriteTimeout;
+        writeback_policy.dirtyRatio = mCacheConfig.data().dirty_ratio / 100.0;
+        writeback_policy.buffersPerSecond = mCacheConfig.data().writeback_rate;
+        mImplementor->SetWritebackPolicy(writeback_policy);
+        if (!mImplementor->SetWriteMode(static_cast<WRITE_MODE>(mCacheConfig.data().write_mode)))
+            std::cout << "write mode not supported by this cache, writing back" << std::endl;
+        if (mThreadPlacement.NumberOfNodes() > 1)
+            mImplementor->PlaceMemory(mThreadPlacement.MemoryNodes());
+
+        /*
+         * Background thread ticks with the timer wheel to reclaim expired buffers, applies buffered hits
+         * and ages frequencies every mFrequencyDecayPeriod
+        */
         auto func_flush_cache = [this](){
 
+            auto last_decay = std::chrono::steady_clock::now();
             while(!mDone.load(std::memory_order_relaxed)){
 
-                mImplementor->Flush();
-                std::this_thread::sleep_for(mCacheTimeOut);
+                mImplementor->AdvanceTimers();
+                mImplementor->DrainReadBuffers();
+                mImplementor->RelocateBuffers(mRelocateBatch);
+                if (mFrequencyDecayPeriod.count() && std::chrono::steady_clock::now() - last_decay >= mFrequencyDecayPeriod){
+
+                    mImplementor->AgeFrequencies();
+                    last_decay = std::chrono::steady_clock::now();
+                }
+                std::this_thread::sleep_for(mImplementor->TimerResolution());
             }
-            mImplementor->Flush();
         };
-        std::thread thread_cache_invalidator(func_flush_cache);
-        thread_cache_invalidator.detach();
+        mCacheInvalidatorThread = std::thread(func_flush_cache);
+
+        /*
+         * Writeback thread wakes every mCacheTimeOut (BDFLUSHR) to write buffers dirty longer than
+         * mDelayedWriteTimeout (NAUTOUP), earlier when dirty ratio is crossed or eviction hits a dirty buffer
+        */
+        mWritebackThread = std::thread([this](){
+
+            while(!mDone.load(std::memory_order_relaxed))
+                mImplementor->Writeback(mImplementor->TimerResolution());
+            mImplementor->Flush();
+        });
+
+        // prefetches of detected streams are loaded off the reader threads
+        if (mCacheConfig.data().readahead){
+
+            mReadaheadThread = std::thread([this](){
+
+                while(!mDone.load(std::memory_order_relaxed))
+                    mImplementor->Readahead(mImplementor->TimerResolution());
+            });
+        }
     }
 
 private:
     std::atomic_bool mDone = false;
     cache_impl_type mImplementor;
+    std::unique_ptr<ShardsProfiler<Key>> mProfiler;     //miss ratio curve, null when not sampling
+    std::unique_ptr<PerfCounters> mPerfCounters;        //hardware counters per operation, null when off
     const cache_config& mCacheConfig;
+    ThreadPlacement mThreadPlacement;                   //where reader/writer threads and cache memory go
     kernel_parameter_time_seconds mCacheTimeOut;        //buffer cache flush timeout - BDFLUSHR
     kernel_parameter_time_seconds mDelayedWriteTimeout; //delayed write flush timeout - NAUTOUP
+    kernel_parameter_time_seconds mDefaultTimeToLive;   //expiry of entries Put without TTL, 0 never expires
+    kernel_parameter_time_seconds mFrequencyDecayPeriod;//LFU frequencies are halved every period, 0 never
+    static constexpr std::size_t mRelocateBatch = 256;  //buffers emptied per tick while shrinking
+    std::thread mCacheInvalidatorThread;
+    std::thread mReadaheadThread;
+    std::thread mWritebackThread;
 };
 
+/*
+ * @brief       one time run time dispatch of cache.stratergy to a CacheManager whose policy is
+ *              bound at compile time, p_Func is called with the shared pointer of that manager
+ *              shared memory caches (USING_BOOST_IPC) are only reachable through the virtual interface
+ *
+ * @return      whatever p_Func returns
+*/
+template<typename Key, typename Value, template<class, class> class HashMapStrorage=std::unordered_map, typename Func>
+decltype(auto) DispatchCacheManager(const cache_config& p_Config, Func&& p_Func){
+
+#ifdef USING_BOOST_IPC
+    if (!p_Config.data().shared_memory_name.empty())
+        return p_Func(std::make_shared<CacheManager<Key, Value, HashMapStrorage>>(p_Config));
+#endif
+    switch((ALGO)p_Config.data().stratergy){
+
+        case ALGO::LFU:
+        default:
+            if (static_cast<SLOT_LAYOUT>(p_Config.data().slot_layout) == SLOT_LAYOUT::DENSE){
+
+                using policy_type = LFUImplementation<Key, Value, HashMapStrorage, SLOT_LAYOUT::DENSE>;
+                return p_Func(std::make_shared<CacheManager<Key, Value, HashMapStrorage, policy_type>>(p_Config));
+            }
+            return p_Func(std::make_shared<CacheManager<Key, Value, HashMapStrorage, LFUImplementation<Key, Value, HashMapStrorage>>>(p_Config));
+    }
+}
+
 #endif // CACHEMANAGER_H
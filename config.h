@@ -112,12 +112,18 @@ std::ostream& operator<<(std::ostream& s, const config<DATA>& c) {
         else if (auto v = boost::any_cast<short>(&value)) {
             s << *v << std::endl;
         }
+        else if (auto v = boost::any_cast<std::size_t>(&value)) {
+            s << *v << std::endl;
+        }
         else if (auto v = boost::any_cast<long>(&value)) {
             s << *v << std::endl;
         }
         else if (auto v = boost::any_cast<int>(&value)) {
             s << *v << std::endl;
         }
+        else if (auto v = boost::any_cast<double>(&value)) {
+            s << *v << std::endl;
+        }
         else if (auto v = boost::any_cast<std::string>(&value)) {
             s << *v << std::endl;
         }
@@ -129,17 +135,42 @@ std::ostream& operator<<(std::ostream& s, const config<DATA>& c) {
 }
 
 struct cache_config_data {
-    short cache_size;
+    std::size_t cache_size;
+    std::size_t max_cache_size;
+    std::size_t memory_budget;
+    short huge_pages;
+    short slot_layout;
+    std::size_t warm_tier_budget;
+    double mrc_sample_rate;
+    short perf_counters;
+    short trace_events;
+    std::string trace_file;
+    std::string mrc_trace;
     std::string reader_file_name;
     std::string writer_file_name;
+    std::size_t writer_appliers;
     std::string items_file_name;
+    short key_type;
     short stratergy;
     int cache_timeout;
+    int delayed_write_timeout;
+    short dirty_ratio;
+    short write_mode;
+    std::size_t writeback_rate;
+    int default_ttl;
+    std::size_t readahead;
+    int frequency_decay_period;
+    std::string thread_placement;
+    std::string reader_cpus;
+    std::string writer_cpus;
+    uint16_t server_port;
+    std::size_t server_threads;
+    std::string shared_memory_name;
     short run_test;
 
     cache_config_data() :
-        cache_size{}, reader_file_name{}, writer_file_name{}, items_file_name{}, stratergy{},
-        cache_timeout{}, run_test{}
+        cache_size{}, max_cache_size{}, memory_budget{}, huge_pages{}, slot_layout{}, warm_tier_budget{}, mrc_sample_rate{}, perf_counters{}, trace_events{}, trace_file{}, mrc_trace{}, reader_file_name{}, writer_file_name{}, writer_appliers{}, items_file_name{}, key_type{}, stratergy{},
+        cache_timeout{}, delayed_write_timeout{}, dirty_ratio{}, write_mode{}, writeback_rate{}, default_ttl{}, readahead{}, frequency_decay_period{}, thread_placement{}, reader_cpus{}, writer_cpus{}, server_port{}, server_threads{}, shared_memory_name{}, run_test{}
     {}
 };
 using cache_config = config<cache_config_data>;
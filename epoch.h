@@ -0,0 +1,245 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+
+/*
+ * Epoch based reclamation (Fraser, same contract as userspace RCU) for structures read without a lock.
+ * A reader publishes the epoch it entered in a slot of its own, writers unlink first and Retire after,
+ * retired memory is freed once every reader inside an epoch entered after it was retired.
+ *  # - entering/leaving only stores to the thread's own cache line, nothing shared is written
+ *  # - one domain per process like RCU, each thread claims a slot on first use and frees it on exit
+ *  # - readers beyond mMaxThreads get no slot, callers take their locked path then
+*/
+class EpochDomain
+{
+public:
+    using epoch_type = uint64_t;
+    static constexpr std::size_t mMaxThreads = 256;
+    static constexpr epoch_type QUIESCENT = 0;
+    static constexpr std::size_t mReclaimBatch = 64;                     //retirements between inline reclaims
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    ~EpochDomain(){
+
+        // no reader is left at exit
+        for (auto& retired : mRetired)
+            retired.second();
+    }
+
+    static EpochDomain& Global(){
+
+        static EpochDomain domain;
+        return domain;
+    }
+
+    /*
+     * Scope of one read side critical section, nested guards of a thread share the outermost epoch
+    */
+    class Guard
+    {
+    public:
+        explicit Guard(EpochDomain& p_Domain)
+            :mDomain(p_Domain), mEntered(p_Domain.Enter()){}
+
+        ~Guard(){
+
+            if (mEntered)
+                mDomain.Exit();
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        explicit operator bool() const{
+
+            return mEntered;
+        }
+
+    private:
+        EpochDomain& mDomain;
+        const bool mEntered;
+    };
+
+    /*
+     * @brief       hand p_Reclaim over to be run once no reader can still reach what it frees,
+     *              caller must have unlinked it already
+     *
+     * @return      void
+    */
+    void Retire(std::function<void()> p_Reclaim){
+
+        std::size_t pending;
+        {
+            std::lock_guard lk(mRetiredGuard);
+            // readers entering from now on see the epoch after this one, so they can not reach it
+            const epoch_type retired_in = mGlobalEpoch.fetch_add(1, std::memory_order_seq_cst);
+            mRetired.emplace_back(retired_in, std::move(p_Reclaim));
+            pending = mRetired.size();
+        }
+        if (pending >= mReclaimBatch)
+            Reclaim();
+    }
+
+    /*
+     * @brief       run the reclaim functions retired before the oldest epoch any reader is still in
+     *
+     * @return      number of reclaimed objects
+    */
+    std::size_t Reclaim(){
+
+        std::vector<std::function<void()>> reclaimable;
+        {
+            std::lock_guard lk(mRetiredGuard);
+            const epoch_type oldest = OldestActiveEpoch();
+            auto itr = mRetired.begin();
+            for (; itr != mRetired.end() && itr->first < oldest; ++itr)
+                reclaimable.push_back(std::move(itr->second));
+            mRetired.erase(mRetired.begin(), itr);
+        }
+        for (auto& reclaim : reclaimable)
+            reclaim();
+        return reclaimable.size();
+    }
+
+    std::size_t Pending() const{
+
+        std::lock_guard lk(mRetiredGuard);
+        return mRetired.size();
+    }
+
+private:
+    // thread slots are per thread not per domain, so there is only the global one
+    EpochDomain(){
+
+        for (auto& slot : mSlots){
+
+            slot.epoch.store(QUIESCENT, std::memory_order_relaxed);
+            slot.owned.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    struct alignas(64) Slot{
+
+        std::atomic<epoch_type> epoch;
+        std::atomic<bool> owned;
+    };
+
+    // claims a slot on first use and gives it back when the thread exits
+    struct ThreadSlot{
+
+        EpochDomain* domain = nullptr;
+        int index = -1;
+        uint32_t depth = 0;
+
+        ~ThreadSlot(){
+
+            if (domain && index >= 0)
+                domain->mSlots[index].owned.store(false, std::memory_order_release);
+        }
+    };
+
+    ThreadSlot& ThisThread(){
+
+        static thread_local ThreadSlot slot;
+        if (slot.domain == nullptr){
+
+            slot.domain = this;
+            for (std::size_t i = 0; i < mMaxThreads; ++i){
+
+                bool owned = false;
+                if (mSlots[i].owned.compare_exchange_strong(owned, true, std::memory_order_acq_rel)){
+
+                    slot.index = static_cast<int>(i);
+                    break;
+                }
+            }
+        }
+        return slot;
+    }
+
+    bool Enter(){
+
+        ThreadSlot& slot = ThisThread();
+        if (slot.index < 0)
+            return false;
+        if (slot.depth++ > 0)
+            return true;
+
+        /*
+         * Publish the epoch and read it again, a reclaimer that scanned the slot before the publish
+         * had already advanced the epoch so the second read sees it moved and the reader retries
+        */
+        std::atomic<epoch_type>& mine = mSlots[slot.index].epoch;
+        epoch_type epoch = mGlobalEpoch.load(std::memory_order_seq_cst);
+        for (;;){
+
+            mine.store(epoch, std::memory_order_seq_cst);
+            const epoch_type current = mGlobalEpoch.load(std::memory_order_seq_cst);
+            if (current == epoch)
+                return true;
+            epoch = current;
+        }
+    }
+
+    void Exit(){
+
+        ThreadSlot& slot = ThisThread();
+        if (--slot.depth == 0)
+            mSlots[slot.index].epoch.store(QUIESCENT, std::memory_order_release);
+    }
+
+    // caller must hold mRetiredGuard
+    epoch_type OldestActiveEpoch() const{
+
+        epoch_type oldest = mGlobalEpoch.load(std::memory_order_seq_cst);
+        for (const auto& slot : mSlots){
+
+            const epoch_type epoch = slot.epoch.load(std::memory_order_seq_cst);
+            if (epoch != QUIESCENT && epoch < oldest)
+                oldest = epoch;
+        }
+        return oldest;
+    }
+
+private:
+    std::atomic<epoch_type> mGlobalEpoch{1};
+    std::array<Slot, mMaxThreads> mSlots;
+    std::vector<std::pair<epoch_type, std::function<void()>>> mRetired;  //in retire order, so in epoch order
+    mutable std::mutex mRetiredGuard;
+};
+
+#endif // EPOCH_H
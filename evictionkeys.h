@@ -0,0 +1,191 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef EVICTION_KEYS_H
+#define EVICTION_KEYS_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <immintrin.h>
+
+/*
+ * Dense array with one 16 bit eviction key per buffer: the LFU frequency of a VALID/DIRTY buffer,
+ * NOT_EVICTABLE for BUSY/FREE ones. The victim scan reads 2 bytes per buffer instead of a whole
+ * cache line and compares 32 (AVX-512BW) or 16 (AVX2) keys per instruction, scalar otherwise.
+ *  # - the buffer stays the source of truth, keys are synced after every store/CAS on it
+ *  # - SIMD loads race with the relaxed stores of Sync, a torn view only picks a worse victim
+ *      and eviction still has to win the CAS on the buffer itself
+*/
+class EvictionKeys
+{
+public:
+    static constexpr uint16_t NOT_EVICTABLE = 0xFFFF;
+    static constexpr std::size_t mLanes = 32;                           //keys per AVX-512 register, array padded to it
+
+    explicit EvictionKeys(std::size_t p_NumberOfBuffers)
+        :mSize(p_NumberOfBuffers), mPaddedSize((p_NumberOfBuffers + mLanes - 1) / mLanes * mLanes),
+          mKeys(new std::atomic<uint16_t>[mPaddedSize]){
+
+        for (std::size_t i = 0; i < mPaddedSize; ++i)
+            mKeys[i].store(NOT_EVICTABLE, std::memory_order_relaxed);
+    }
+
+    EvictionKeys(const EvictionKeys&) = delete;
+    EvictionKeys& operator=(const EvictionKeys&) = delete;
+
+    /*
+     * @brief       copy the key of buffer p_Index from p_LoadKey() (which loads the buffer),
+     *              reloading until it did not change under the store so racing syncs of one
+     *              buffer can not leave an older key behind
+     *
+     * @return      void
+    */
+    template<typename LoadKey>
+    void Sync(std::size_t p_Index, LoadKey&& p_LoadKey){
+
+        uint16_t key = p_LoadKey();
+        for (;;){
+
+            mKeys[p_Index].store(key, std::memory_order_relaxed);
+            const uint16_t reloaded = p_LoadKey();
+            if (reloaded == key)
+                return;
+            key = reloaded;
+        }
+    }
+
+    uint16_t Key(std::size_t p_Index) const{
+
+        return mKeys[p_Index].load(std::memory_order_relaxed);
+    }
+
+    /*
+     * @brief       index of the smallest key, first one on ties
+     *
+     * @return      buffer index, -1 if every buffer is NOT_EVICTABLE
+    */
+    int FindMinimum() const{
+
+#if defined(__AVX512BW__)
+        return FindMinimumAVX512();
+#elif defined(__AVX2__)
+        return FindMinimumAVX2();
+#else
+        return FindMinimumScalar();
+#endif
+    }
+
+    int FindMinimumScalar() const{
+
+        int victim = -1;
+        uint16_t least = NOT_EVICTABLE;
+        for (std::size_t i = 0; i < mSize; ++i){
+
+            const uint16_t key = Key(i);
+            if (key < least){
+
+                least = key;
+                victim = static_cast<int>(i);
+            }
+        }
+        return victim;
+    }
+
+#if defined(__AVX2__)
+    int FindMinimumAVX2() const{
+
+        // pass 1 folds 16 keys per step to the minimum, pass 2 finds where it is
+        const uint16_t* keys = Raw();
+        __m256i least = _mm256_set1_epi16((short)NOT_EVICTABLE);
+        for (std::size_t i = 0; i < mPaddedSize; i += 16)
+            least = _mm256_min_epu16(least, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)));
+        const uint16_t minimum = HorizontalMinimum(_mm_min_epu16(_mm256_castsi256_si128(least), _mm256_extracti128_si256(least, 1)));
+        if (minimum == NOT_EVICTABLE)
+            return -1;
+
+        const __m256i wanted = _mm256_set1_epi16((short)minimum);
+        for (std::size_t i = 0; i < mPaddedSize; i += 16){
+
+            const __m256i equal = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), wanted);
+            const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(equal));
+            if (mask)
+                return static_cast<int>(i + (__builtin_ctz(mask) / 2));
+        }
+        // key changed between the passes
+        return FindMinimumScalar();
+    }
+#endif
+
+#if defined(__AVX512BW__)
+    int FindMinimumAVX512() const{
+
+        const uint16_t* keys = Raw();
+        __m512i least = _mm512_set1_epi16((short)NOT_EVICTABLE);
+        for (std::size_t i = 0; i < mPaddedSize; i += mLanes)
+            least = _mm512_min_epu16(least, _mm512_loadu_si512(keys + i));
+        const __m256i half = _mm256_min_epu16(_mm512_castsi512_si256(least), _mm512_extracti64x4_epi64(least, 1));
+        const uint16_t minimum = HorizontalMinimum(_mm_min_epu16(_mm256_castsi256_si128(half), _mm256_extracti128_si256(half, 1)));
+        if (minimum == NOT_EVICTABLE)
+            return -1;
+
+        const __m512i wanted = _mm512_set1_epi16((short)minimum);
+        for (std::size_t i = 0; i < mPaddedSize; i += mLanes){
+
+            const __mmask32 equal = _mm512_cmpeq_epi16_mask(_mm512_loadu_si512(keys + i), wanted);
+            if (equal)
+                return static_cast<int>(i + __builtin_ctz(equal));
+        }
+        return FindMinimumScalar();
+    }
+#endif
+
+    std::size_t Size() const{
+
+        return mSize;
+    }
+
+private:
+    // std::atomic<uint16_t> is lock free and laid out as a plain uint16_t
+    const uint16_t* Raw() const{
+
+        static_assert(sizeof(std::atomic<uint16_t>) == sizeof(uint16_t));
+        return reinterpret_cast<const uint16_t*>(mKeys.get());
+    }
+
+#if defined(__AVX2__)
+    static uint16_t HorizontalMinimum(__m128i p_Keys){
+
+        // phminposuw, minimum of 8 unsigned 16 bit lanes in the low word
+        return static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(p_Keys)) & 0xFFFF);
+    }
+#endif
+
+private:
+    const std::size_t mSize;
+    const std::size_t mPaddedSize;
+    std::unique_ptr<std::atomic<uint16_t>[]> mKeys;
+};
+
+#endif // EVICTION_KEYS_H
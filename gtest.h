@@ -23,9 +23,39 @@
 // Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
 
 #include "cachemanager.h"
+#include "server.h"
+#include "writer.h"
 #include <gtest/gtest.h>
+#include <filesystem>
+#include <sys/wait.h>
+#include <random>
+#include <map>
+#include <set>
 #include <unordered_map>
 
+/*
+ * @brief       config of a CacheManager under test, p_Set fills the fields the test cares about
+ *              on top of a small LFU cache, config file options are left unregistered so they do not apply
+ *
+ * @return      parsed config, must outlive the cache manager
+*/
+template<typename Set>
+std::unique_ptr<cache_config> MakeTestConfig(Set&& p_Set){
+
+    auto config = std::make_unique<cache_config>([p_Set](cache_config_data& d, boost::program_options::options_description&){
+
+        d.cache_size = 16;
+        d.items_file_name = "../InMemoryCacheForCpp/res/item_file.txt";
+        d.cache_timeout = 5;
+        d.thread_placement = "compact";
+        p_Set(d);
+    });
+    char program[] = "gtest";
+    char* argv[] = {program};
+    config->parse(1, argv);
+    return config;
+}
+
 TEST(CacheManagerTest, PutGetCache) {
 
     // Int data
@@ -64,6 +94,14 @@ TEST(CacheManagerTest, PutGetCache) {
     int vsi_truc2;
     imp_signed_int_truc2.Get(1000, vsi_truc2);
     ASSERT_EQ(-1111111, vsi_truc2);
+
+    // line numbers outside the items file are refused instead of written past its mapping
+    imp_signed_int_truc2.Put(20000, 5);
+    imp_signed_int_truc2.Put(0, 5);
+    imp_signed_int_truc2.Put(-3, 5);
+    imp_signed_int_truc2.Flush();
+    ASSERT_EQ(1u, imp_signed_int_truc2.ForEachEntry([](const CacheEntry<short, int>&){ return true; }));
+    ASSERT_FALSE(imp_signed_int_truc2.Lookup(20000, vsi_truc2));
 }
 
 TEST(CacheManagerTest, CacheEvictionTest) {
@@ -90,6 +128,1197 @@ TEST(CacheManagerTest, CacheEvictionTest) {
     ASSERT_EQ(r, ifDataTakenFromDisk_CacheMiss);
 }
 
+TEST(CacheManagerTest, VariableLengthValueTest) {
+
+    LFUImplementation<short, std::string, std::unordered_map> imp(2,"../InMemoryCacheForCpp/res/item_file.txt");
+    const std::string small(100, 'a'), medium(1000, 'b'), large(4096, 'c');
+    std::string v;
+
+    imp.Put(1, small);
+    imp.Put(2, large);
+    imp.Get(1, v);
+    ASSERT_EQ(small, v);
+    imp.Get(2, v);
+    ASSERT_EQ(large, v);
+
+    // shrink in to smaller size class
+    imp.Put(2, medium);
+    imp.Get(2, v);
+    ASSERT_EQ(medium, v);
+
+    // 1 has lower frequency so gets evicted and written as variable length record
+    imp.Put(3, "third");
+    bool r = imp.Get(1, v);
+    ASSERT_EQ(small, v);
+    ASSERT_TRUE(r);
+
+    ASSERT_THROW(imp.Put(4, std::string(SlabAllocator::mMaxChunkSize + 1, 'd')), std::length_error);
+}
+
+TEST(CacheManagerTest, WideAndStringKeyTest) {
+
+    LFUImplementation<std::int64_t, int, std::unordered_map> imp_wide(2,"../InMemoryCacheForCpp/res/item_file.txt");
+    int v;
+    imp_wide.Put(5000000000, 1);
+    imp_wide.Put(5000000001, 2);
+    imp_wide.Get(5000000001, v);
+    imp_wide.Put(7, 3); // evict 5000000000 to the keyed record file
+    ASSERT_TRUE(imp_wide.Get(5000000000, v));
+    ASSERT_EQ(1, v);
+
+    const StringKey inline_key("user:42"), heap_key("a-natural-string-id-longer-than-inline-storage");
+    ASSERT_EQ(StringKey("user:42"), inline_key);
+    ASSERT_NE(inline_key, heap_key);
+    ASSERT_EQ(std::hash<std::string_view>{}(heap_key.view()), heap_key.hash());
+
+    LFUImplementation<StringKey, int, std::unordered_map> imp_string(2,"../InMemoryCacheForCpp/res/item_file.txt");
+    imp_string.Put(inline_key, 42);
+    imp_string.Put(heap_key, 43);
+    imp_string.Get(heap_key, v);
+    imp_string.Put(StringKey("other"), 44); // evict inline_key
+    ASSERT_TRUE(imp_string.Get(inline_key, v));
+    ASSERT_EQ(42, v);
+    ASSERT_FALSE(imp_string.Get(StringKey("user:42"), v));
+}
+
+TEST(CacheManagerTest, TimeToLiveExpiryTest) {
+
+    LFUImplementation<short, int, std::unordered_map> imp(4,"../InMemoryCacheForCpp/res/item_file.txt");
+    int v;
+    imp.Put(1, 1111, 150ms);
+    imp.Put(2, 2222, 150ms);
+    imp.Put(3, 3333);
+    imp.Put(2, 2223, 0ms); // re-Put without TTL cancels the timer
+
+    std::this_thread::sleep_for(400ms);
+    ASSERT_EQ(1u, imp.AdvanceTimers());
+
+    // expired entry was written back and its buffer reclaimed, next Get is a miss
+    ASSERT_TRUE(imp.Get(1, v));
+    ASSERT_EQ(1111, v);
+    ASSERT_FALSE(imp.Get(2, v));
+    ASSERT_EQ(2223, v);
+    ASSERT_FALSE(imp.Get(3, v));
+}
+
+TEST(CacheManagerTest, MemoryBudgetTest) {
+
+    constexpr std::size_t budget = 64 * 1024;
+    const std::string items_file = "../InMemoryCacheForCpp/res/budget_test_item_file.txt";
+    using imp_type = LFUImplementation<int64_t, std::string, std::unordered_map>;
+    {
+        imp_type imp(imp_type::BuffersForMemoryBudget(budget), items_file);
+        imp.SetMemoryBudget(budget);
+        std::string v;
+
+        // 40 values of 4KB can not fit 64KB, least frequently used ones go out first
+        for (int64_t i = 0; i < 40; ++i){
+
+            imp.Put(i, std::string(4096, 'a' + (i % 26)));
+            ASSERT_LE(imp.MemoryUsage().Total(), budget);
+        }
+        ASSERT_LT(imp.MemoryUsage().numberOfEntries, 16u);
+
+        // evicted entries were written back and come in again on a miss
+        int misses = 0;
+        for (int64_t i = 0; i < 40; ++i){
+
+            misses += imp.Get(i, v);
+            ASSERT_EQ(std::string(4096, 'a' + (i % 26)), v);
+            ASSERT_LE(imp.MemoryUsage().Total(), budget);
+        }
+        ASSERT_GE(misses, 24);
+
+        // slab pages emptied by removing the large values are given back, small values fill many more entries
+        for (int64_t i = 0; i < 40; ++i)
+            imp.Remove(i);
+        ASSERT_LT(imp.MemoryUsage().reservedPayloadBytes, SlabAllocator::mMaxChunkSize);
+        for (int64_t i = 100; i < 200; ++i)
+            imp.Put(i, "v");
+        const CacheMemoryUsage usage = imp.MemoryUsage();
+        ASSERT_GT(usage.numberOfEntries, 16u);
+        ASSERT_GE(usage.reservedPayloadBytes, usage.payloadBytes);
+        ASSERT_LE(usage.Total(), budget);
+    }
+    std::filesystem::remove(items_file);
+}
+
+TEST(CacheManagerTest, SequentialReadaheadTest) {
+
+    LFUImplementation<short, int, std::unordered_map> imp(64,"../InMemoryCacheForCpp/res/item_file.txt");
+    int v;
+    // expiry writes everything back and leaves the cache empty
+    for (short i = 1; i <= 40; ++i)
+        imp.Put(i, i * 10, 100ms);
+    std::this_thread::sleep_for(250ms);
+    ASSERT_EQ(40u, imp.AdvanceTimers());
+
+    // two misses with the same stride make a stream, next 4 lines are queued
+    imp.SetReadahead(4);
+    ASSERT_TRUE(imp.Get(1, v));
+    ASSERT_TRUE(imp.Get(2, v));
+    ASSERT_EQ(4u, imp.Readahead(0ms));
+
+    // prefetched lines are hits, first use slides the window
+    for (short i = 3; i <= 6; ++i){
+
+        ASSERT_FALSE(imp.Get(i, v));
+        ASSERT_EQ(i * 10, v);
+    }
+    ASSERT_EQ(4u, imp.ReadaheadStatistics().used);
+    ASSERT_EQ(4u, imp.Readahead(0ms));
+    ASSERT_FALSE(imp.Get(7, v));
+    ASSERT_EQ(70, v);
+
+    // random access is not a stream
+    imp.Readahead(0ms);
+    imp.Get(33, v);
+    imp.Get(12, v);
+    imp.Get(27, v);
+    ASSERT_EQ(0u, imp.Readahead(0ms));
+}
+
+TEST(CacheManagerTest, BufferedHitFrequencyTest) {
+
+    LFUImplementation<short, int, std::unordered_map> imp(2,"../InMemoryCacheForCpp/res/item_file.txt");
+    int v;
+    imp.Put(1, 1111);
+    imp.Put(2, 2222);
+
+    // hits of a hot key from many threads only append to read buffers
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 8; ++t){
+
+        readers.emplace_back([&imp](){
+
+            int value;
+            for (int i = 0; i < 1000; ++i){
+
+                imp.Get(1, value);
+                ASSERT_EQ(1111, value);
+            }
+        });
+    }
+    for (auto& reader : readers)
+        reader.join();
+    imp.DrainReadBuffers();
+
+    // lossy but enough hits of 1 got applied, 2 is least frequently used
+    imp.Put(3, 3333);
+    ASSERT_FALSE(imp.Get(1, v));
+    ASSERT_TRUE(imp.Get(2, v));
+    ASSERT_EQ(2222, v);
+
+    // a copy that still has to be validated is not a hit until RecordHit
+    imp.DrainReadBuffers();
+    std::size_t valid = 0;
+    for (int index = 0; index < 2; ++index)
+        valid += imp.ReadCachedValue(index, v);
+    ASSERT_EQ(2u, valid);
+    ASSERT_EQ(0u, imp.DrainReadBuffers());
+    imp.RecordHit(0);
+    ASSERT_EQ(1u, imp.DrainReadBuffers());
+}
+
+TEST(CacheManagerTest, FrequencyDecayTest) {
+
+    LFUImplementation<short, int, std::unordered_map> imp(2,"../InMemoryCacheForCpp/res/item_file.txt");
+    int v;
+    imp.Put(1, 1111);
+    imp.Put(2, 2222);
+    for (int i = 0; i < 10; ++i)
+        imp.Get(1, v);
+
+    // 1 was hot long ago, 11 halves to 0 after 4 periods
+    for (int i = 0; i < 4; ++i)
+        imp.AgeFrequencies();
+    imp.Get(2, v);
+    imp.Get(2, v);
+
+    imp.Put(3, 3333);
+    ASSERT_FALSE(imp.Get(2, v));
+    ASSERT_TRUE(imp.Get(1, v));
+    ASSERT_EQ(1111, v);
+}
+
+TEST(CacheManagerTest, ThreadPlacementTest) {
+
+    // 2 nodes, 2 cores per node, 2 SMT siblings per core
+    const std::string root = "/tmp/cache_topology_test";
+    auto write_file = [](const std::string& p_Path, const std::string& p_Text){
+
+        std::filesystem::create_directories(std::filesystem::path(p_Path).parent_path());
+        std::ofstream(p_Path) << p_Text << std::endl;
+    };
+    write_file(root + "/cpu/online", "0-7");
+    write_file(root + "/node/node0/cpulist", "0-1,4-5");
+    write_file(root + "/node/node1/cpulist", "2-3,6-7");
+    for (int cpu = 0; cpu < 8; ++cpu){
+
+        write_file(root + "/cpu/cpu" + std::to_string(cpu) + "/topology/core_id", std::to_string(cpu % 4));
+        write_file(root + "/cpu/cpu" + std::to_string(cpu) + "/topology/physical_package_id", std::to_string((cpu % 4) / 2));
+    }
+    const CpuTopology topology(root);
+    ASSERT_EQ(8u, topology.Cpus().size());
+    ASSERT_EQ((std::vector<int>{0, 1}), topology.Nodes());
+
+    auto next_cpus = [](ThreadPlacement& p_Placement, THREAD_ROLE p_Role, int p_Threads){
+
+        std::vector<int> cpus;
+        for (int i = 0; i < p_Threads; ++i)
+            for (int cpu : p_Placement.NextCpus(p_Role))
+                cpus.push_back(cpu);
+        return cpus;
+    };
+
+    // siblings of a core first, then next core of the same node
+    ThreadPlacement compact(topology, THREAD_PLACEMENT::COMPACT);
+    ASSERT_EQ((std::vector<int>{0, 4, 1, 5, 2}), next_cpus(compact, THREAD_ROLE::READER, 5));
+    ASSERT_EQ((std::vector<int>{0}), compact.MemoryNodes());
+
+    // every core before any sibling, alternating nodes
+    ThreadPlacement spread(topology, THREAD_PLACEMENT::SPREAD);
+    ASSERT_EQ((std::vector<int>{0, 2, 1, 3, 4, 6}), next_cpus(spread, THREAD_ROLE::WRITER, 6));
+    ASSERT_EQ((std::vector<int>{0, 1}), spread.MemoryNodes());
+
+    ThreadPlacement per_node(topology, THREAD_PLACEMENT::PER_NODE);
+    ASSERT_EQ((std::vector<int>{0, 4, 1, 5}), per_node.NextCpus(THREAD_ROLE::READER));
+    ASSERT_EQ((std::vector<int>{2, 6, 3, 7}), per_node.NextCpus(THREAD_ROLE::READER));
+
+    ThreadPlacement explicit_lists(topology, THREAD_PLACEMENT::EXPLICIT, CpuTopology::ParseCpuList("6-7"), CpuTopology::ParseCpuList("2"));
+    ASSERT_EQ((std::vector<int>{6, 7, 6}), next_cpus(explicit_lists, THREAD_ROLE::READER, 3));
+    ASSERT_EQ((std::vector<int>{2}), next_cpus(explicit_lists, THREAD_ROLE::WRITER, 1));
+    ASSERT_EQ((std::vector<int>{1}), explicit_lists.MemoryNodes());
+
+    ASSERT_TRUE(CpuTopology::ParseCpuList("1,x").empty());
+    std::filesystem::remove_all(root);
+}
+
+TEST(CacheManagerTest, WritebackSchedulerTest) {
+
+    LFUImplementation<short, int, std::unordered_map> imp(10,"../InMemoryCacheForCpp/res/item_file.txt");
+    WritebackPolicy policy;
+    policy.interval = 1h;
+    policy.delayedWriteAge = 1h;
+    policy.dirtyRatio = 0.5;
+    imp.SetWritebackPolicy(policy);
+
+    // under the dirty ratio nothing is due before the interval
+    for (short i = 1; i <= 4; ++i)
+        imp.Put(i, i);
+    ASSERT_EQ(0u, imp.Writeback(0ms));
+
+    // crossing it writes back until under half of the ratio
+    imp.Put(5, 5);
+    ASSERT_EQ(3u, imp.Writeback(0ms));
+    ASSERT_EQ(2u, imp.WritebackStatistics().dirtyBuffers);
+
+    // rate limit caps a pass
+    policy.buffersPerSecond = 2;
+    imp.SetWritebackPolicy(policy);
+    for (short i = 6; i <= 10; ++i)
+        imp.Put(i, i);
+    ASSERT_EQ(2u, imp.Writeback(0ms));
+    ASSERT_EQ(5u, imp.WritebackStatistics().dirtyBuffers);
+
+    // everything clean, eviction does not have to write
+    imp.Flush();
+    ASSERT_EQ(0u, imp.WritebackStatistics().dirtyBuffers);
+    imp.Put(11, 11);
+    ASSERT_EQ(0u, imp.WritebackStatistics().dirtyEvictions);
+    ASSERT_EQ(1u, imp.WritebackStatistics().cleanEvictions);
+}
+
+TEST(CacheManagerTest, MemcachedServerTest) {
+
+    using cache_type = LFUImplementation<StringKey, std::string, std::unordered_map>;
+    auto cache = std::make_shared<cache_type>(16, "../InMemoryCacheForCpp/res/server_test_item_file.txt");
+    MemcachedServer<StringKey, std::string, cache_type> server(cache, 0, 2);
+    server.Listen();
+    std::thread server_thread([&server](){ server.execute(); });
+
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(server.Port());
+    ASSERT_EQ(0, ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+
+    auto exchange = [fd](const std::string& p_Request, std::size_t p_ReplyLength, int p_Fd = -1){
+
+        const int socket_fd = (p_Fd < 0 ? fd : p_Fd);
+        ::send(socket_fd, p_Request.data(), p_Request.size(), MSG_NOSIGNAL);
+        std::string reply;
+        char buffer[1024];
+        while (reply.size() < p_ReplyLength){
+
+            const ssize_t received = ::recv(socket_fd, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+                break;
+            reply.append(buffer, received);
+        }
+        return reply;
+    };
+
+    // pipelined requests in one write, value split across two writes
+    std::string expected = "STORED\r\nSTORED\r\nVALUE k1 7 5\r\nhello\r\nEND\r\nVALUE k2 0 3 0\r\nabc\r\nEND\r\nDELETED\r\nEND\r\nNOT_FOUND\r\n";
+    ::send(fd, "set k1 7 0 5\r\nhel", 17, MSG_NOSIGNAL);
+    std::this_thread::sleep_for(50ms);
+    ASSERT_EQ(expected, exchange("lo\r\nset k2 0 0 3 \r\nabc\r\nget k1 missing\r\ngets k2\r\ndelete k1\r\nget k1\r\ndelete k1\r\n", expected.size()));
+
+    expected = "ERROR\r\nCLIENT_ERROR bad command line format\r\nVERSION lock_free_cache\r\n";
+    ASSERT_EQ(expected, exchange("bogus\r\nset k3 x 0 1\r\nset k4 0 0 1 noreply\r\nz\r\nversion\r\n", expected.size()));
+    expected = "VALUE k4 0 1\r\nz\r\nEND\r\n";
+    ASSERT_EQ(expected, exchange("get k4\r\n", expected.size()));
+    ::close(fd);
+
+    // oversized announcement is refused without waiting for its data, a block without \r\n is rejected
+    auto connect_again = [&address](){
+
+        const int again = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::connect(again, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        return again;
+    };
+    const int large = connect_again();
+    ::send(large, "set big 0 0 4000000000\r\n", 25, MSG_NOSIGNAL);
+    char reply[128] = {};
+    ASSERT_GT(::recv(large, reply, sizeof(reply) - 1, 0), 0);
+    ASSERT_STREQ("SERVER_ERROR object too large for cache\r\n", reply);
+    ASSERT_EQ(0, ::recv(large, reply, sizeof(reply), 0));
+    ::close(large);
+    const int chunk = connect_again();
+    ::send(chunk, "set k5 0 0 1\r\nzz\r\n", 19, MSG_NOSIGNAL);
+    std::memset(reply, 0, sizeof(reply));
+    ASSERT_GT(::recv(chunk, reply, sizeof(reply) - 1, 0), 0);
+    ASSERT_STREQ("CLIENT_ERROR bad data chunk\r\n", reply);
+    ::close(chunk);
+
+    // past exptime misses even once written back, an absolute exptime of now has passed already
+    const int expiring = connect_again();
+    expected = "STORED\r\nSTORED\r\nSTORED\r\nVALUE k6 0 1\r\nx\r\nVALUE k8 0 1\r\nw\r\nEND\r\n";
+    ASSERT_EQ(expected, exchange("set k6 0 1 1\r\nx\r\nset k7 0 " + std::to_string(std::time(nullptr)) + " 1\r\ny\r\n"
+                                 "set k8 0 1 1\r\nw\r\nget k6 k7 k8\r\n", expected.size(), expiring));
+    cache->Flush();
+    std::this_thread::sleep_for(1500ms);
+    ASSERT_EQ(2u, cache->AdvanceTimers());
+    expected = "END\r\nEND\r\n";
+    ASSERT_EQ(expected, exchange("get k6 k8\r\nget k7\r\n", expected.size(), expiring));
+    ::close(expiring);
+
+    server.Stop();
+    server_thread.join();
+    std::filesystem::remove("../InMemoryCacheForCpp/res/server_test_item_file.txt");
+}
+
+TEST(CacheManagerTest, HugePageBackingTest) {
+
+    // 40000 buffers of 64 bytes are past the huge page threshold, small caches stay on the heap
+    LFUImplementation<short, int, std::unordered_map> imp(40000,"../InMemoryCacheForCpp/res/item_file.txt", HUGE_PAGES::TRANSPARENT);
+    LFUImplementation<short, int, std::unordered_map> small(4,"../InMemoryCacheForCpp/res/item_file.txt", HUGE_PAGES::TRANSPARENT);
+    ASSERT_EQ(0u, small.MemoryUsage().hugePages.mappedBytes);
+
+    for (short i = 1; i <= 100; ++i)
+        imp.Put(i, i * 10);
+    int v = 0;
+    imp.Get(42, v);
+    ASSERT_EQ(420, v);
+
+    const HugePageStats stats = imp.MemoryUsage().hugePages;
+    ASSERT_GE(stats.mappedBytes, 40000 * sizeof(LFUCacheBuffer<short, int>));
+    ASSERT_EQ(0u, stats.mappedBytes % HugePageAllocator<char>::mHugePageSize);
+    ASSERT_FALSE(stats.hugeTlb);
+    ASSERT_LE(stats.backedBytes, stats.mappedBytes);
+}
+
+TEST(CacheManagerTest, DenseSlotLayoutTest) {
+
+    // SIMD scan must agree with the scalar one, first index on ties, -1 when nothing is evictable
+    EvictionKeys keys(1000);
+    ASSERT_EQ(-1, keys.FindMinimum());
+    std::mt19937 rng(7);
+    for (std::size_t i = 0; i < keys.Size(); ++i)
+        keys.Sync(i, [&](){ return (i % 5 == 0) ? EvictionKeys::NOT_EVICTABLE : static_cast<uint16_t>(100 + rng() % 1000); });
+    ASSERT_EQ(keys.FindMinimumScalar(), keys.FindMinimum());
+    keys.Sync(997, [](){ return uint16_t(3); });
+    keys.Sync(998, [](){ return uint16_t(3); });
+    ASSERT_EQ(997, keys.FindMinimum());
+
+    using dense_type = LFUImplementation<short, int, std::unordered_map, SLOT_LAYOUT::DENSE>;
+    using padded_type = LFUImplementation<short, int, std::unordered_map>;
+    ASSERT_GT(dense_type::BuffersForMemoryBudget(1 << 20), padded_type::BuffersForMemoryBudget(1 << 20));
+
+    dense_type imp(4,"../InMemoryCacheForCpp/res/item_file.txt");
+    int v = 0;
+    for (short i = 1; i <= 4; ++i)
+        imp.Put(i, i * 10);
+    for (short i = 2; i <= 4; ++i)
+        for (int j = 0; j < 3; ++j)
+            imp.Get(i, v);
+    imp.DrainReadBuffers();
+
+    // 1 is the least frequently used, so 5 takes its buffer (Get returns true on a miss)
+    imp.Put(5, 50);
+    for (short i = 2; i <= 5; ++i){
+
+        ASSERT_FALSE(imp.Get(i, v));
+        ASSERT_EQ(i * 10, v);
+    }
+    ASSERT_TRUE(imp.Get(1, v));
+    ASSERT_EQ(10, v);
+
+    // equally cold entries, both layouts pick the first buffer and evict the same key
+    auto resident_after_eviction = [](auto& p_Imp){
+
+        for (short i = 1; i <= 4; ++i)
+            p_Imp.Put(i, i * 10);
+        const auto victim = p_Imp.FindVictim();
+        p_Imp.Put(5, 50);
+        std::set<short> resident;
+        p_Imp.ForEachEntry([&resident](const CacheEntry<short, int>& p_Entry){ return resident.insert(p_Entry.key).second; });
+        return std::make_pair(victim, resident);
+    };
+    dense_type dense(4,"../InMemoryCacheForCpp/res/item_file.txt");
+    padded_type padded(4,"../InMemoryCacheForCpp/res/item_file.txt");
+    const auto dense_result = resident_after_eviction(dense);
+    ASSERT_EQ(0u, dense_result.first);
+    ASSERT_EQ(dense_result, resident_after_eviction(padded));
+}
+
+TEST(CacheManagerTest, SnapshotTest) {
+
+    LFUImplementation<short, int, std::unordered_map> imp(8,"../InMemoryCacheForCpp/res/item_file.txt");
+    int v = 0;
+    for (short i = 1; i <= 4; ++i)
+        imp.Put(i, i * 10);
+    imp.Get(2, v);
+    imp.Get(2, v);
+    imp.Flush();
+    imp.Put(3, 33);
+
+    std::map<short, CacheEntry<short, int>> entries;
+    ASSERT_EQ(4u, imp.ForEachEntry([&entries](const CacheEntry<short, int>& p_Entry){
+
+        entries[p_Entry.key] = p_Entry;
+        return true;
+    }));
+    ASSERT_EQ(4u, entries.size());
+    for (short i = 1; i <= 4; ++i)
+        ASSERT_EQ(i == 3 ? 33 : i * 10, entries[i].value);
+    ASSERT_EQ(3, entries[2].frequency);
+    ASSERT_FALSE(entries[2].dirty);
+    ASSERT_TRUE(entries[3].dirty);
+
+    // writers keep evicting and updating, every entry seen must still pair key with its own value
+    imp.Put(3, 30);
+    std::atomic<bool> done = false;
+    std::thread writer([&imp, &done](){
+
+        while (!done.load())
+            for (short i = 1; i <= 64; ++i)
+                imp.Put(i, i * 10);
+    });
+    std::size_t inconsistent = 0, seen = 0;
+    for (int pass = 0; pass < 200; ++pass){
+
+        seen += imp.ForEachEntry([&inconsistent](const CacheEntry<short, int>& p_Entry){
+
+            if (p_Entry.value != p_Entry.key * 10)
+                inconsistent++;
+            return true;
+        });
+    }
+    done.store(true);
+    writer.join();
+    ASSERT_EQ(0u, inconsistent);
+    ASSERT_GT(seen, 0u);
+}
+
+TEST(CacheManagerTest, EpochReclamationTest) {
+
+    // a node unlinked while a reader is inside an epoch survives until the reader leaves
+    ReadIndex<short> index(4);
+    index.Insert(7, 3, 1);
+    int32_t buffer = -1;
+    uint32_t version = 0;
+    {
+        EpochDomain::Guard guard(EpochDomain::Global());
+        ASSERT_TRUE(guard);
+        ASSERT_TRUE(index.Find(7, buffer, version));
+        ASSERT_EQ(3, buffer);
+        ASSERT_EQ(1u, version);
+        ASSERT_TRUE(index.Erase(7));
+        ASSERT_FALSE(index.Find(7, buffer, version));
+        EpochDomain::Global().Reclaim();
+        ASSERT_GE(EpochDomain::Global().Pending(), 1u);
+    }
+    EpochDomain::Global().Reclaim();
+    ASSERT_EQ(0u, EpochDomain::Global().Pending());
+
+    // lock free hits racing with evictions must never return the value of the key that reused the buffer
+    LFUImplementation<short, int, std::unordered_map> imp(8,"../InMemoryCacheForCpp/res/item_file.txt");
+    for (short i = 1; i <= 32; ++i)
+        imp.Put(i, i * 10);
+    std::atomic<bool> done = false;
+    std::thread writer([&imp, &done](){
+
+        while (!done.load())
+            for (short i = 1; i <= 32; ++i)
+                imp.Put(i, i * 10);
+    });
+    std::atomic<std::size_t> wrong{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r){
+
+        readers.emplace_back([&imp, &wrong](){
+
+            int v = 0;
+            for (int round = 0; round < 2000; ++round){
+
+                const short key = 1 + (round % 32);
+                imp.Get(key, v);
+                if (v != key * 10)
+                    wrong.fetch_add(1);
+            }
+        });
+    }
+    for (auto& reader : readers)
+        reader.join();
+    done.store(true);
+    writer.join();
+    ASSERT_EQ(0u, wrong.load());
+}
+
+TEST(CacheManagerTest, WarmTierTest) {
+
+    // neighbouring keys pack into one block of a few bytes per entry
+    WarmTier<int64_t> tier(1 << 20);
+    for (int64_t i = 0; i < 64; ++i)
+        tier.Insert(i, std::to_string(i * 10));
+    WarmTierStats stats = tier.Statistics();
+    ASSERT_EQ(64u, stats.entries);
+    ASSERT_EQ(1u, stats.blocks);
+    ASSERT_LT(stats.usedBytes, 64 * 6 + WarmTier<int64_t>::mBlockOverhead);
+    std::string record;
+    ASSERT_TRUE(tier.Take(42, record));
+    ASSERT_EQ("420", record);
+    ASSERT_FALSE(tier.Take(42, record));
+    tier.Insert(-5, "x");
+    ASSERT_TRUE(tier.Take(-5, record));
+    ASSERT_EQ("x", record);
+
+    WarmTier<StringKey> hashed(1 << 20);
+    hashed.Insert(StringKey("alpha"), "1");
+    hashed.Insert(StringKey("beta"), "2");
+    ASSERT_TRUE(hashed.Take(StringKey("beta"), record));
+    ASSERT_EQ("2", record);
+    ASSERT_TRUE(hashed.Erase(StringKey("alpha")));
+    ASSERT_EQ(0u, hashed.Statistics().entries);
+
+    // over the budget least recently used blocks go first
+    WarmTier<int64_t> small(3 * WarmTier<int64_t>::mBlockOverhead);
+    for (int64_t block = 0; block < 8; ++block)
+        small.Insert(block * 64, "v");
+    ASSERT_LE(small.Statistics().usedBytes, 3 * WarmTier<int64_t>::mBlockOverhead);
+    ASSERT_GT(small.Statistics().dropped, 0u);
+    ASSERT_TRUE(small.Take(7 * 64, record));
+
+    // evicted entries are promoted back from the warm tier on the next Get
+    LFUImplementation<short, int, std::unordered_map> imp(4,"../InMemoryCacheForCpp/res/item_file.txt");
+    imp.SetWarmTierBudget(1 << 16);
+    for (short i = 1; i <= 12; ++i)
+        imp.Put(i, i * 10);
+    ASSERT_EQ(8u, imp.WarmTierStatistics().entries);
+    std::set<short> resident;
+    imp.ForEachEntry([&resident](const CacheEntry<short, int>& p_Entry){ return resident.insert(p_Entry.key).second; });
+    short evicted = 1;
+    while (resident.count(evicted))
+        evicted++;
+    int v = 0;
+    ASSERT_TRUE(imp.Get(evicted, v));
+    ASSERT_EQ(evicted * 10, v);
+    ASSERT_EQ(1u, imp.WarmTierStatistics().hits);
+    // promotion evicted another entry into the tier
+    ASSERT_EQ(8u, imp.WarmTierStatistics().entries);
+
+    // a new value makes the warm copy stale
+    imp.Put(5, 555);
+    ASSERT_FALSE(imp.Get(5, v));
+    ASSERT_EQ(555, v);
+    ASSERT_TRUE(imp.Remove(6));
+    ASSERT_FALSE(imp.Lookup(6, v));
+}
+
+TEST(CacheManagerTest, ResizeTest) {
+
+    LFUImplementation<short, int, std::unordered_map> imp(4,"../InMemoryCacheForCpp/res/item_file.txt", HUGE_PAGES::OFF, 16);
+    ASSERT_EQ(4u, imp.NumberOfBuffers());
+    ASSERT_FALSE(imp.Resize(17));
+    for (short i = 1; i <= 4; ++i)
+        imp.Put(i, i * 10);
+
+    // growing uses the reserved buffers without evicting
+    ASSERT_TRUE(imp.Resize(8));
+    for (short i = 5; i <= 8; ++i)
+        imp.Put(i, i * 10);
+    WritebackStats stats = imp.WritebackStatistics();
+    ASSERT_EQ(0u, stats.dirtyEvictions + stats.cleanEvictions);
+
+    // shrinking keeps the hot half wherever its buffers were
+    int v = 0;
+    for (short i = 5; i <= 8; ++i)
+        for (int j = 0; j < 4; ++j)
+            imp.Get(i, v);
+    imp.DrainReadBuffers();
+    ASSERT_TRUE(imp.Resize(4));
+    while (imp.RelocateBuffers(256));
+    std::set<short> resident;
+    imp.ForEachEntry([&resident](const CacheEntry<short, int>& p_Entry){ return resident.insert(p_Entry.key).second; });
+    ASSERT_EQ((std::set<short>{5, 6, 7, 8}), resident);
+    for (short i = 8; i >= 1; --i){
+
+        ASSERT_EQ(i <= 4, imp.Get(i, v));
+        ASSERT_EQ(i * 10, v);
+    }
+
+    // resizing back and forth under writers never mixes up keys
+    std::atomic<bool> done = false;
+    std::thread writer([&imp, &done](){
+
+        do{
+
+            for (short i = 1; i <= 32; ++i)
+                imp.Put(i, i * 10);
+        }while (!done.load());
+    });
+    for (int round = 0; round < 20; ++round){
+
+        imp.Resize(round % 2 ? 16 : 2);
+        imp.RelocateBuffers(4);
+    }
+    imp.Resize(3);
+    while (imp.RelocateBuffers(256));
+    done.store(true);
+    writer.join();
+    while (imp.RelocateBuffers(256));
+    std::size_t entries = 0;
+    imp.ForEachEntry([&entries](const CacheEntry<short, int>& p_Entry){ entries++; return p_Entry.value == p_Entry.key * 10; });
+    ASSERT_LE(entries, 3u);
+    for (short i = 1; i <= 32; ++i){
+
+        imp.Get(i, v);
+        ASSERT_EQ(i * 10, v);
+    }
+
+    // dirty ratio is of the buffers in use, 2 of 4 cross half although 16 are reserved
+    LFUImplementation<short, int, std::unordered_map> reserved(4,"../InMemoryCacheForCpp/res/item_file.txt", HUGE_PAGES::OFF, 16);
+    WritebackPolicy policy;
+    policy.interval = 1h;
+    policy.delayedWriteAge = 1h;
+    policy.dirtyRatio = 0.5;
+    reserved.SetWritebackPolicy(policy);
+    reserved.Put(1, 10);
+    ASSERT_EQ(0u, reserved.Writeback(0ms));
+    reserved.Put(2, 20);
+    ASSERT_EQ(1u, reserved.Writeback(0ms));
+}
+
+TEST(CacheManagerTest, MissRatioCurveTest) {
+
+    // cyclic scan of 40 keys: LRU misses everything below 40 buffers and hits every reuse from 40 on
+    ShardsProfiler<int> exact(40, 1.0);
+    for (int round = 0; round < 20; ++round)
+        for (int key = 0; key < 40; ++key)
+            exact.Access(key);
+    MissRatioCurve curve = exact.Curve(40);
+    ASSERT_EQ(800u, curve.sampledReferences);
+    ASSERT_EQ(ShardsProfiler<int>::mCapacityFactors.size(), curve.points.size());
+    for (const auto& point : curve.points){
+
+        if (point.capacity < 40)
+            ASSERT_DOUBLE_EQ(0.0, point.hitRatio);
+        else
+            ASSERT_DOUBLE_EQ(19.0 / 20, point.hitRatio);
+    }
+
+    // sampled at 10% the same shape shows up scaled back to the full key space
+    ShardsProfiler<int> sampled(2000, 0.1);
+    for (int round = 0; round < 10; ++round)
+        for (int key = 0; key < 2000; ++key)
+            sampled.Access(key);
+    curve = sampled.Curve(2000);
+    ASSERT_LT(curve.sampledReferences, 20000u / 5);
+    ASSERT_NEAR(0.0, curve.points[2].hitRatio, 0.05);           //0.75x
+    ASSERT_NEAR(0.9, curve.points[4].hitRatio, 0.05);           //1.5x
+
+    // fixed size: tracked keys stay bounded, the rate adapts down
+    ShardsProfiler<int> bounded(2000, 1.0, 64);
+    for (int round = 0; round < 10; ++round)
+        for (int key = 0; key < 2000; ++key)
+            bounded.Access(key);
+    curve = bounded.Curve(2000);
+    ASSERT_LE(curve.trackedKeys, 64u);
+    ASSERT_LT(curve.sampleRate, 0.1);
+    ASSERT_GT(curve.points[4].hitRatio, 0.7);
+}
+
+TEST(CacheManagerTest, WriteModeTest) {
+
+    const std::string items_file = "../InMemoryCacheForCpp/res/write_mode_item_file.txt";
+    {
+        // write through: persisted right away, buffers stay clean
+        LFUImplementation<short, int, std::unordered_map> imp(4, items_file);
+        ASSERT_TRUE(imp.SetWriteMode(WRITE_MODE::WRITE_THROUGH));
+        for (short i = 1; i <= 3; ++i)
+            imp.Put(i, i * 10);
+        imp.Put(2, 22);
+        WritebackStats stats = imp.WritebackStatistics();
+        ASSERT_EQ(0u, stats.dirtyBuffers);
+        ASSERT_EQ(4u, stats.writtenThrough);
+        ASSERT_EQ(3u, imp.ForEachEntry([](const CacheEntry<short, int>& p_Entry){ return !p_Entry.dirty; }));
+
+        // write around: no buffer taken, a cached copy is dropped and the next Get reads the new value
+        ASSERT_TRUE(imp.SetWriteMode(WRITE_MODE::WRITE_AROUND));
+        imp.Put(9, 90);
+        imp.Put(1, 11);
+        stats = imp.WritebackStatistics();
+        ASSERT_EQ(2u, stats.writtenAround);
+        std::set<short> resident;
+        imp.ForEachEntry([&resident](const CacheEntry<short, int>& p_Entry){ return resident.insert(p_Entry.key).second; });
+        ASSERT_EQ((std::set<short>{2, 3}), resident);
+        int v = 0;
+        ASSERT_TRUE(imp.Get(9, v));
+        ASSERT_EQ(90, v);
+        ASSERT_TRUE(imp.Get(1, v));
+        ASSERT_EQ(11, v);
+        ASSERT_FALSE(imp.Get(2, v));
+        ASSERT_EQ(22, v);
+    }
+    {
+        // hits bumping frequencies of the same buffers do not leave a write through Put DIRTY
+        LFUImplementation<short, int, std::unordered_map> imp(4, items_file);
+        ASSERT_TRUE(imp.SetWriteMode(WRITE_MODE::WRITE_THROUGH));
+        constexpr int rounds = 300;
+        std::atomic<bool> done = false;
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r){
+
+            readers.emplace_back([&imp, &done](){
+
+                int v;
+                while (!done.load())
+                    for (short i = 1; i <= 3; ++i)
+                        imp.Get(i, v);
+            });
+        }
+        for (int round = 1; round <= rounds; ++round)
+            for (short i = 1; i <= 3; ++i)
+                imp.Put(i, round * 10 + i);
+        done.store(true);
+        for (auto& t : readers)
+            t.join();
+        const WritebackStats stats = imp.WritebackStatistics();
+        ASSERT_EQ(0u, stats.dirtyBuffers);
+        ASSERT_EQ(3u * rounds, stats.writtenThrough);
+        ASSERT_EQ(3u, imp.ForEachEntry([](const CacheEntry<short, int>& p_Entry){ return !p_Entry.dirty; }));
+    }
+    std::filesystem::remove(items_file);
+}
+
+TEST(CacheManagerTest, CleanLoadTest) {
+
+    const std::string items_file = "../InMemoryCacheForCpp/res/clean_load_item_file.txt";
+    {
+        // 1..4 are written back as 5..8 evict them, all clean after the flush
+        LFUImplementation<short, int, std::unordered_map> imp(4, items_file);
+        for (short i = 1; i <= 8; ++i)
+            imp.Put(i, i * 10);
+        imp.Flush();
+        const std::size_t written = imp.WritebackStatistics().written;
+
+        // values loaded on a miss are what the items file holds, nothing to write back
+        std::set<short> resident;
+        imp.ForEachEntry([&resident](const CacheEntry<short, int>& p_Entry){ return resident.insert(p_Entry.key).second; });
+        int v = 0;
+        for (short i = 1; i <= 8; ++i){
+
+            if (resident.count(i))
+                continue;
+            ASSERT_TRUE(imp.Get(i, v));
+            ASSERT_EQ(i * 10, v);
+        }
+        WritebackStats stats = imp.WritebackStatistics();
+        ASSERT_EQ(0u, stats.dirtyBuffers);
+        ASSERT_EQ(4u, stats.cleanLoads);
+
+        // same value again leaves the buffer clean, a new one dirties it
+        resident.clear();
+        imp.ForEachEntry([&resident](const CacheEntry<short, int>& p_Entry){ return resident.insert(p_Entry.key).second; });
+        imp.Put(*resident.begin(), *resident.begin() * 10);
+        ASSERT_EQ(0u, imp.WritebackStatistics().dirtyBuffers);
+        imp.Put(*resident.rbegin(), 1);
+        imp.Flush();
+        stats = imp.WritebackStatistics();
+        ASSERT_EQ(written + 1, stats.written);
+        ASSERT_EQ(1u, stats.unchangedWrites);
+        ASSERT_EQ(5u, stats.WritebacksAvoided());
+    }
+    std::filesystem::remove(items_file);
+
+    const std::string string_items_file = "../InMemoryCacheForCpp/res/clean_load_string_item_file.txt";
+    {
+        LFUImplementation<StringKey, std::string, std::unordered_map> imp(4, string_items_file);
+        imp.Put(StringKey("alpha"), "first");
+        imp.Flush();
+        imp.Put(StringKey("alpha"), "first");
+        ASSERT_EQ(0u, imp.WritebackStatistics().dirtyBuffers);
+        imp.Put(StringKey("alpha"), "firsT");
+        ASSERT_EQ(1u, imp.WritebackStatistics().dirtyBuffers);
+        ASSERT_EQ(1u, imp.WritebackStatistics().unchangedWrites);
+        std::string value;
+        ASSERT_FALSE(imp.Get(StringKey("alpha"), value));
+        ASSERT_EQ("firsT", value);
+    }
+    std::filesystem::remove(string_items_file);
+}
+
+TEST(CacheManagerTest, MissCoalescingTest) {
+
+    // followers of a flight wait until the leader's ticket is gone
+    SingleFlight<int> flights;
+    std::atomic<bool> landed = false;
+    std::thread follower;
+    {
+        auto leader = flights.Join(7);
+        ASSERT_TRUE(leader.Leader());
+        follower = std::thread([&flights, &landed](){
+
+            auto ticket = flights.Join(7);
+            if (!ticket.Leader())
+                ticket.Wait();
+            landed.store(true);
+        });
+        while (flights.Coalesced() == 0)
+            std::this_thread::yield();
+        std::this_thread::sleep_for(10ms);
+        ASSERT_FALSE(landed.load());
+        ASSERT_TRUE(flights.Join(8).Leader());
+    }
+    follower.join();
+    ASSERT_TRUE(landed.load());
+    ASSERT_TRUE(flights.Join(7).Leader());
+
+    // a herd missing on one key loads it once
+    LFUImplementation<short, int, std::unordered_map> imp(4,"../InMemoryCacheForCpp/res/item_file.txt");
+    imp.Put(2, 20);
+    // push 2 out (written back on eviction), it is only in the items file then
+    auto resident = [&imp](short p_Key){
+
+        bool found = false;
+        imp.ForEachEntry([p_Key, &found](const CacheEntry<short, int>& p_Entry){ found |= (p_Entry.key == p_Key); return !found; });
+        return found;
+    };
+    for (short key = 3; key <= 40 && resident(2); ++key){
+
+        // hotter than 2 so it is the victim
+        imp.Put(key, key);
+        imp.Put(key, key + 1);
+    }
+    ASSERT_FALSE(resident(2));
+
+    const std::size_t loads = imp.MissStatistics().loads;
+    std::atomic<int> ready = 0;
+    std::vector<std::thread> herd;
+    std::atomic<int> wrong = 0;
+    for (int i = 0; i < 8; ++i){
+
+        herd.emplace_back([&imp, &ready, &wrong](){
+
+            ready.fetch_add(1);
+            while (ready.load() < 8)
+                std::this_thread::yield();
+            int v = 0;
+            imp.Get(2, v);
+            if (v != 20)
+                wrong.fetch_add(1);
+        });
+    }
+    for (auto& t : herd)
+        t.join();
+    ASSERT_EQ(0, wrong.load());
+    ASSERT_EQ(loads + 1, imp.MissStatistics().loads);
+}
+
+TEST(CacheManagerTest, MpmcRingTest) {
+
+    MpmcRing<int> small(3);
+    ASSERT_EQ(4u, small.Capacity());
+    for (int i = 0; i < 4; ++i)
+        ASSERT_TRUE(small.TryPush(i));
+    int extra = 4, v = -1;
+    ASSERT_FALSE(small.TryPush(extra));
+    ASSERT_TRUE(small.TryPop(v));
+    ASSERT_EQ(0, v);
+    ASSERT_TRUE(small.TryPush(extra));
+
+    // every value pushed by 4 producers is popped exactly once by 4 consumers
+    MpmcRing<std::vector<int>> ring(16);
+    constexpr int producers = 4, batches = 2000;
+    std::atomic<long> sum = 0;
+    std::atomic<int> popped = 0;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p){
+
+        threads.emplace_back([&ring, p](){
+
+            for (int b = 0; b < batches; ++b){
+
+                std::vector<int> batch{p, b};
+                while (!ring.TryPush(batch))
+                    std::this_thread::yield();
+            }
+        });
+        threads.emplace_back([&ring, &sum, &popped](){
+
+            std::vector<int> batch;
+            while (popped.load() < producers * batches){
+
+                if (!ring.TryPop(batch)){
+
+                    std::this_thread::yield();
+                    continue;
+                }
+                sum.fetch_add(batch[0] * batches + batch[1]);
+                popped.fetch_add(1);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    const long n = producers * batches;
+    ASSERT_EQ(n, popped.load());
+    ASSERT_EQ(n * (n - 1) / 2, sum.load());
+}
+
+TEST(CacheManagerTest, PipelinedWriterTest) {
+
+    // two writer files, every key updated twice within its file so the result depends on per key order
+    const std::string res = "../InMemoryCacheForCpp/res/";
+    const std::string list = res + "writer_test_list.txt";
+    const std::vector<std::string> parts = {res + "writer_test_1.txt", res + "writer_test_2.txt"};
+    {
+        std::ofstream list_out(list);
+        for (std::size_t f = 0; f < parts.size(); ++f){
+
+            list_out << parts[f] << "\n";
+            std::ofstream part(parts[f]);
+            for (int round = 0; round < 2; ++round)
+                for (int key = 1 + f * 100; key <= 100 + (int)f * 100; ++key)
+                    part << key << " " << (key * 10 + round) << "\n";
+        }
+    }
+
+    auto run = [&list, &res](std::size_t p_Appliers){
+
+        auto config = MakeTestConfig([&list, &res, p_Appliers](cache_config_data& d){
+
+            d.cache_size = 256;
+            d.items_file_name = res + "writer_test_item_file.txt";
+            d.writer_file_name = list;
+            d.writer_appliers = p_Appliers;
+        });
+        using cache_type = CacheManager<short, double, std::unordered_map, LFUImplementation<short, double, std::unordered_map>>;
+        auto cache = std::make_shared<cache_type>(*config);
+        {
+            Writer<short, double, cache_type> writer(cache);
+            writer.execute();
+            while (Command::mCurrThreadsAlive.load() != 0)
+                std::this_thread::sleep_for(1ms);
+            std::unique_lock parsers_done(gCheckProgramExit);
+        }
+        std::map<short, double> contents;
+        for (short key = 1; key <= 200; ++key)
+            cache->Get(key, contents[key]);
+        return contents;
+    };
+
+    const std::map<short, double> direct = run(0);
+    for (const auto& [key, value] : direct)
+        ASSERT_EQ(key * 10 + 1, value) << key;
+    ASSERT_EQ(direct, run(2));
+
+    for (const std::string& file : {list, parts[0], parts[1], res + "writer_test_item_file.txt"})
+        std::filesystem::remove(file);
+}
+
+TEST(CacheManagerTest, StaticPolicyTest) {
+
+    const std::string items_file = "../InMemoryCacheForCpp/res/static_policy_item_file.txt";
+    for (short layout : {(short)SLOT_LAYOUT::PADDED, (short)SLOT_LAYOUT::DENSE}){
+
+        auto config = MakeTestConfig([&items_file, layout](cache_config_data& d){
+
+            d.cache_size = 4;
+            d.items_file_name = items_file;
+            d.slot_layout = layout;
+        });
+        DispatchCacheManager<short, int>(*config, [layout](auto p_Cache){
+
+            // configured layout is bound at compile time, not behind the virtual interface
+            using cache_type = typename decltype(p_Cache)::element_type;
+            ASSERT_FALSE((std::is_same_v<cache_type, CacheManager<short, int>>));
+            ASSERT_EQ(4u, p_Cache->NumberOfBuffers());
+
+            // 5..8 evict 1..4, which come back from the items file after the flush
+            for (short i = 1; i <= 8; ++i)
+                p_Cache->Put(i, i * 10 + layout);
+            p_Cache->Flush();
+            ASSERT_EQ(0u, p_Cache->WritebackStatistics().dirtyBuffers);
+            int v = 0;
+            for (short i = 1; i <= 8; ++i){
+
+                p_Cache->Get(i, v);
+                ASSERT_EQ(i * 10 + layout, v) << i;
+            }
+            p_Cache->Put(2, 7);
+            ASSERT_EQ(1u, p_Cache->WritebackStatistics().dirtyBuffers);
+            p_Cache->Flush();
+            ASSERT_EQ(0u, p_Cache->WritebackStatistics().dirtyBuffers);
+            ASSERT_FALSE(p_Cache->Get(2, v));
+            ASSERT_EQ(7, v);
+        });
+    }
+    std::filesystem::remove(items_file);
+}
+
+TEST(CacheManagerTest, PerfCountersTest) {
+
+    PerfCounters counters;
+    {
+        PerfCounters::Measurement off(nullptr, PERF_OPERATION::GET);
+    }
+    ASSERT_EQ(0u, counters.Statistics().operations[(int)PERF_OPERATION::GET].operations);
+
+    // operations and wall time are counted whether or not the PMU is reachable
+    LFUImplementation<short, int, std::unordered_map> imp(2,"../InMemoryCacheForCpp/res/item_file.txt");
+    imp.SetPerfCounters(&counters);
+    for (short key = 1; key <= 4; ++key)
+        imp.Put(key, key * 10);
+    imp.Flush();
+    PerfStats stats = counters.Statistics();
+    ASSERT_EQ(PerfCounters::AvailableEvents(), stats.availableEvents);
+    ASSERT_GE(stats.operations[(int)PERF_OPERATION::EVICT].operations, 2u);
+    ASSERT_EQ(1u, stats.operations[(int)PERF_OPERATION::FLUSH].operations);
+    ASSERT_GT(stats.operations[(int)PERF_OPERATION::FLUSH].nanoseconds, 0u);
+    // events that were not opened, or never got on the PMU, count nothing
+    const PerfOperationStats& flush = stats.operations[(int)PERF_OPERATION::FLUSH];
+    ASSERT_LE(flush.countedOperations, flush.operations);
+    for (int event = 0; event < (int)PERF_EVENT::MAX_EVENT; ++event){
+
+        if (!stats.Available(PERF_OPERATION::FLUSH, static_cast<PERF_EVENT>(event))){
+
+            ASSERT_EQ(0u, flush.events[event]);
+        }
+    }
+
+    imp.SetPerfCounters(nullptr);
+    imp.Flush();
+    ASSERT_EQ(1u, counters.Statistics().operations[(int)PERF_OPERATION::FLUSH].operations);
+}
+
+TEST(CacheManagerTest, EventTracerTest) {
+
+    EventTracer& tracer = EventTracer::Instance();
+    std::ostringstream off;
+    {
+        TraceSpan span(TRACE_EVENT::FLUSH);
+    }
+    tracer.Clear();
+    ASSERT_EQ(0u, tracer.ExportChromeTrace(off));
+
+    // evictions of a two buffer cache, their items file writes and the final flush
+    tracer.Enable(true);
+    {
+        LFUImplementation<short, int, std::unordered_map> imp(2,"../InMemoryCacheForCpp/res/item_file.txt");
+        for (short key = 1; key <= 4; ++key)
+            imp.Put(key, key * 10);
+        imp.Flush();
+    }
+    std::ostringstream trace;
+    ASSERT_GT(tracer.ExportChromeTrace(trace), 0u);
+    for (const char* name : {"\"evict\"", "\"get_new_buffer\"", "\"write_item\"", "\"msync\"", "\"flush\""})
+        ASSERT_NE(std::string::npos, trace.str().find(name)) << name;
+    ASSERT_EQ('}', trace.str()[trace.str().find_last_not_of('\n')]);
+
+    // a full ring keeps the newest events of a thread that is gone
+    tracer.Clear();
+    std::thread([](){
+
+        for (std::size_t i = 0; i < EventTracer::mRingCapacity + 10; ++i)
+            TraceSpan span(TRACE_EVENT::RETRY_SLEEP, i);
+    }).join();
+    tracer.Enable(false);
+    std::ostringstream wrapped;
+    ASSERT_EQ(EventTracer::mRingCapacity, tracer.ExportChromeTrace(wrapped));
+    ASSERT_EQ(std::string::npos, wrapped.str().find("\"arg\":9}"));
+    ASSERT_NE(std::string::npos, wrapped.str().find("\"arg\":10}"));
+}
+
+#ifdef USING_BOOST_IPC
+TEST(CacheManagerTest, SharedMemoryCacheTest) {
+
+    const std::string segment = "lfu_cache_test";
+    const std::string items_file = "../InMemoryCacheForCpp/res/shared_item_file.txt";
+    using shared_cache_type = SharedMemoryLFUImplementation<short, int>;
+    shared_cache_type::RemoveSegment(segment);
+    {
+        shared_cache_type creator(4, items_file, segment);
+        creator.Put(1, 100);
+
+        // child attaches to the same segment, sees the parent's value and leaves its own behind
+        const pid_t child = ::fork();
+        if (child == 0){
+
+            shared_cache_type attached(16, items_file, segment);
+            int v = 0;
+            const bool miss = attached.Get(1, v);
+            attached.Put(2, 200);
+            ::_exit((!miss && v == 100 && attached.NumberOfBuffers() == 4) ? 0 : 1);
+        }
+        int status = -1;
+        ASSERT_EQ(child, ::waitpid(child, &status, 0));
+        ASSERT_TRUE(WIFEXITED(status));
+        ASSERT_EQ(0, WEXITSTATUS(status));
+
+        int v = 0;
+        ASSERT_FALSE(creator.Get(2, v));
+        ASSERT_EQ(200, v);
+        creator.Put(20000, 5);
+        ASSERT_EQ(2u, creator.WritebackStatistics().dirtyBuffers);
+        ASSERT_EQ(2u, creator.ForEachEntry([](const CacheEntry<short, int>& p_Entry){
+
+            return (p_Entry.dirty && p_Entry.value == p_Entry.key * 100);
+        }));
+
+        // evicted dirty values are written back and read again on miss
+        for (short i = 3; i <= 8; ++i)
+            creator.Put(i, i * 100);
+        ASSERT_GE(creator.WritebackStatistics().dirtyEvictions, 4u);
+        for (short i = 1; i <= 8; ++i){
+
+            creator.Get(i, v);
+            ASSERT_EQ(i * 100, v);
+        }
+
+        ASSERT_TRUE(creator.Remove(1));
+        ASSERT_FALSE(creator.Lookup(1, v));
+        creator.Flush();
+        ASSERT_EQ(0u, creator.WritebackStatistics().dirtyBuffers);
+    }
+    shared_cache_type::RemoveSegment(segment);
+    std::filesystem::remove(items_file);
+}
+#endif
+
 int RunGTest(int argc, char **argv) {
 
     testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,195 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <new>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <sys/mman.h>
+
+#include "utilstructs.h"
+
+enum class HUGE_PAGES: int8_t{
+
+    OFF = 0,
+    EXPLICIT,               //MAP_HUGETLB from the reserved pool, transparent huge pages if the pool is empty
+    TRANSPARENT,            //2MB aligned anonymous mapping with madvise(MADV_HUGEPAGE)
+};
+
+/*
+ * Allocator putting big arrays (buffer pool, reverse index) on 2MB pages so randomly hit buffers
+ * do not cost a dTLB miss each. Arrays smaller than half a huge page stay on the heap, rounding
+ * them up would waste more than the TLB entries they save. What was obtained goes to p_Stats.
+*/
+template<typename T>
+class HugePageAllocator
+{
+public:
+    using value_type = T;
+    static constexpr std::size_t mHugePageSize = 2 * 1024 * 1024;
+
+    HugePageAllocator(HUGE_PAGES p_Mode = HUGE_PAGES::OFF, HugePageStats* p_Stats = nullptr) noexcept
+        :mMode(p_Mode), mStats(p_Stats){}
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U>& rhs) noexcept
+        :mMode(rhs.Mode()), mStats(rhs.Stats()){}
+
+    T* allocate(std::size_t p_Count){
+
+        const std::size_t bytes = p_Count * sizeof(T);
+        if (!UseHugePages(bytes))
+            return static_cast<T*>(::operator new(bytes, std::align_val_t(alignof(T))));
+
+        const std::size_t length = RoundUp(bytes);
+        void* address = MAP_FAILED;
+        if (mMode == HUGE_PAGES::EXPLICIT){
+
+            address = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (address != MAP_FAILED && mStats)
+                mStats->hugeTlb = true;
+        }
+        if (address == MAP_FAILED){
+
+            // over map by one huge page and trim so khugepaged can use whole aligned 2MB extents
+            char* raw = static_cast<char*>(::mmap(nullptr, length + mHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (raw == MAP_FAILED)
+                throw std::bad_alloc();
+            char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + mHugePageSize - 1) & ~(uintptr_t)(mHugePageSize - 1));
+            if (aligned != raw)
+                ::munmap(raw, aligned - raw);
+            ::munmap(aligned + length, (raw + mHugePageSize) - aligned);
+            if (::madvise(aligned, length, MADV_HUGEPAGE) == 0 && mStats)
+                mStats->transparent = true;
+            address = aligned;
+        }
+        if (mStats)
+            mStats->mappedBytes += length;
+        return static_cast<T*>(address);
+    }
+
+    void deallocate(T* p_Address, std::size_t p_Count) noexcept{
+
+        const std::size_t bytes = p_Count * sizeof(T);
+        if (!UseHugePages(bytes)){
+
+            ::operator delete(p_Address, std::align_val_t(alignof(T)));
+            return;
+        }
+        ::munmap(p_Address, RoundUp(bytes));
+        if (mStats)
+            mStats->mappedBytes -= RoundUp(bytes);
+    }
+
+    HUGE_PAGES Mode() const noexcept{
+
+        return mMode;
+    }
+
+    HugePageStats* Stats() const noexcept{
+
+        return mStats;
+    }
+
+    template<typename U>
+    bool operator==(const HugePageAllocator<U>& rhs) const noexcept{
+
+        return (mMode == rhs.Mode() && mStats == rhs.Stats());
+    }
+
+    template<typename U>
+    bool operator!=(const HugePageAllocator<U>& rhs) const noexcept{
+
+        return !(*this == rhs);
+    }
+
+private:
+    bool UseHugePages(std::size_t p_Bytes) const{
+
+        return (mMode != HUGE_PAGES::OFF && p_Bytes >= mHugePageSize / 2);
+    }
+
+    static std::size_t RoundUp(std::size_t p_Bytes){
+
+        return (p_Bytes + mHugePageSize - 1) & ~(mHugePageSize - 1);
+    }
+
+private:
+    HUGE_PAGES mMode;
+    HugePageStats* mStats;
+};
+
+/*
+ * @brief       bytes of [p_Address, p_Address + p_Length) the kernel currently backs with huge pages,
+ *              from /proc/self/smaps: hugetlbfs VMAs count whole, otherwise the THP counters
+ *
+ * @return      bytes on huge pages, 0 if smaps is not readable
+*/
+inline std::size_t HugePageBackedBytes(const void* p_Address, std::size_t p_Length){
+
+    if (p_Address == nullptr || p_Length == 0)
+        return 0;
+
+    std::ifstream smaps("/proc/self/smaps");
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(p_Address);
+    const uintptr_t end = begin + p_Length;
+    std::size_t backed_kb = 0;
+    bool overlaps = false;
+    std::size_t rss_kb = 0;
+    std::string line;
+    while (std::getline(smaps, line)){
+
+        // VMA header "start-end perms offset dev inode path", counters follow as "Name: value kB"
+        const std::size_t dash = line.find('-');
+        if (dash != std::string::npos && line.find(':') > line.find(' ')){
+
+            uintptr_t vma_begin = 0, vma_end = 0;
+            std::istringstream(line.substr(0, dash)) >> std::hex >> vma_begin;
+            std::istringstream(line.substr(dash + 1)) >> std::hex >> vma_end;
+            overlaps = (vma_begin < end && begin < vma_end);
+            continue;
+        }
+        if (!overlaps)
+            continue;
+
+        std::istringstream counter(line);
+        std::string name;
+        std::size_t kb = 0;
+        counter >> name >> kb;
+        if (name == "Rss:")
+            rss_kb = kb;
+        else if (name == "KernelPageSize:" && kb >= HugePageAllocator<char>::mHugePageSize / 1024)
+            backed_kb += rss_kb;
+        else if (name == "AnonHugePages:" || name == "ShmemPmdMapped:" || name == "FilePmdMapped:")
+            backed_kb += kb;
+    }
+    return std::min(backed_kb * 1024, p_Length);
+}
+
+#endif // HUGE_PAGES_H
@@ -33,6 +33,7 @@
 #include "cachemanager.h"
 #include "writer.h"
 #include "reader.h"
+#include "server.h"
 #include "gtest.h"
 
 unsigned int Command::mMaxThreadAllowed = 1;
@@ -42,18 +43,195 @@ std::shared_mutex gCheckProgramExit;
 std::condition_variable_any gCheckProgramExitConVar;
 using namespace std::chrono_literals;
 
+void PrintPerfStatistics(const PerfStats& p_Stats)
+{
+    static const char* operation_names[] = {"get", "put", "evict", "flush"};
+    static const char* event_names[] = {"cycles", "instructions", "L1d misses", "LLC misses", "dTLB misses", "branch misses"};
+
+    for (int op = 0; op < (int)PERF_OPERATION::MAX_OPERATION; ++op){
+
+        const PerfOperationStats& operation = p_Stats.operations[op];
+        if (!operation.operations)
+            continue;
+        std::cout << operation_names[op] << ": " << operation.operations << " ops " << (operation.nanoseconds / operation.operations) << " ns/op";
+        for (int event = 0; event < (int)PERF_EVENT::MAX_EVENT; ++event){
+
+            std::cout << " " << event_names[event] << ": ";
+            if (p_Stats.Available(static_cast<PERF_OPERATION>(op), static_cast<PERF_EVENT>(event)))
+                std::cout << operation.PerOperation(static_cast<PERF_EVENT>(event));
+            else
+                std::cout << "unavailable";
+        }
+        std::cout << std::endl;
+    }
+}
+
+template<typename CACHE>
+void RunReaderWriter(std::shared_ptr<CACHE> cache_manager)
+{
+    using KEY = typename CACHE::key_type;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    auto w = std::make_unique<Writer<KEY, double, CACHE>>(cache_manager->Self());
+    auto r = std::make_unique<Reader<KEY, double, CACHE>>(cache_manager->Self());
+    auto func_writer = [&w](){
+
+        std::cout << "Excecuting Writer.." << std::endl;
+        w->execute();
+    };
+    std::thread wt(func_writer);
+    auto func_reader = [&r](){
+
+        std::cout << "Excecuting Reader.." << std::endl;
+        r->execute();
+    };
+    std::thread rt(func_reader);
+
+    rt.join();
+    wt.join();
+
+    std::unique_lock locker(gCheckProgramExit);
+    gCheckProgramExitConVar.wait_for(locker, 10s, []()mutable {
+
+        int c = Command::mCurrThreadsAlive.load(std::memory_order_acquire);
+        return (!c);
+    });
+
+    w.reset();
+    r.reset();
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::chrono::duration<double> diff = end-start;
+    std::cout << "Time to Complete: " << diff.count() << std::endl;
+    PrintPerfStatistics(cache_manager->PerfStatistics());
+}
+
+void ExportTrace(const cache_config& config)
+{
+    if (config.data().trace_file.empty())
+        return;
+    if (EventTracer::Instance().ExportChromeTrace(config.data().trace_file))
+        std::cout << "trace written to " << config.data().trace_file << std::endl;
+    else
+        std::cout << "can not write trace " << config.data().trace_file << std::endl;
+}
+
+template<typename KEY>
+void RunCache(const cache_config& config)
+{
+    // using redis-client key/value storage(opensource) or boost::multi_index_container will give  better performance
+    // stratergy is dispatched once here, the reader/writer hit path is bound to the policy at compile time
+    DispatchCacheManager<KEY, double, std::unordered_map>(config, [](auto cache_manager){
+
+        RunReaderWriter(cache_manager);
+    });
+    ExportTrace(config);
+}
+
+/*
+ * Offline miss ratio curve of a recorded trace, every line starts with a key (reader and writer files both
+ * work), sizes are relative to cache.size_of_cache, every key is profiled unless cache.mrc_sample_rate is set
+*/
+template<typename KEY>
+void RunMissRatioCurve(const cache_config& config)
+{
+    std::ifstream trace(config.data().mrc_trace);
+    if (!trace){
+
+        std::cout << "can not open trace " << config.data().mrc_trace << std::endl;
+        return;
+    }
+
+    const std::size_t cache_size = config.data().cache_size;
+    const double sample_rate = (config.data().mrc_sample_rate > 0 ? config.data().mrc_sample_rate : 1.0);
+    ShardsProfiler<KEY> profiler(cache_size, sample_rate);
+    std::size_t references = 0;
+    std::string line;
+    while (std::getline(trace, line)){
+
+        std::istringstream fields(line);
+        KEY key;
+        if (!(fields >> key))
+            continue;
+        profiler.Access(key);
+        references++;
+    }
+
+    const MissRatioCurve curve = profiler.Curve(cache_size);
+    std::cout << "references: " << references << " sampled: " << curve.sampledReferences << " rate: " << curve.sampleRate << std::endl;
+    for (const auto& point : curve.points)
+        std::cout << "capacity: " << point.capacity << " hit ratio: " << point.hitRatio << std::endl;
+}
+
+void RunServer(const cache_config& config)
+{
+    // SIGINT/SIGTERM are taken by a waiting thread so reactors stop and the cache flushes on exit
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    DispatchCacheManager<StringKey, std::string, std::unordered_map>(config, [&config, signals](auto cache_manager){
+
+        using cache_type = typename decltype(cache_manager)::element_type;
+        const std::size_t reactors = config.data().server_threads ? config.data().server_threads : std::thread::hardware_concurrency();
+        MemcachedServer<StringKey, std::string, cache_type> server(cache_manager->Self(), config.data().server_port, reactors);
+        std::thread signal_waiter([&server, signals](){
+
+            int signal_number;
+            sigwait(&signals, &signal_number);
+            server.Stop();
+        });
+
+        server.execute();
+
+        // server may also return because it could not listen
+        pthread_kill(signal_waiter.native_handle(), SIGTERM);
+        signal_waiter.join();
+    });
+    ExportTrace(config);
+}
+
 int main(int argc, char *argv[])
 {
     //Input: cache <size_of_cache> <reader_file> <writer_file> <items_file>
     cache_config config([](cache_config_data &d, boost::program_options::options_description &desc){
         desc.add_options()
             //("cache.size_of_cache", boost::program_options::value<std::string>(&d.log_file_name)->required(), "cache size available")
-            ("cache.size_of_cache", boost::program_options::value<short>(&d.cache_size)->default_value(4), "cache size available")
+            ("cache.size_of_cache", boost::program_options::value<std::size_t>(&d.cache_size)->default_value(4), "cache size available")
+            ("cache.max_size_of_cache", boost::program_options::value<std::size_t>(&d.max_cache_size)->default_value(0), "buffers reserved so Resize can grow the cache, 0 size_of_cache")
+            ("cache.memory_budget", boost::program_options::value<std::size_t>(&d.memory_budget)->default_value(0), "bytes for buffers, index and values, overrides size_of_cache, 0 disabled")
+            ("cache.huge_pages", boost::program_options::value<short>(&d.huge_pages)->default_value(0), "back buffer pool and index with 2MB pages off: 0, MAP_HUGETLB with transparent fallback: 1, transparent only: 2")
+            ("cache.slot_layout", boost::program_options::value<short>(&d.slot_layout)->default_value(0), "cache buffers one per cache line: 0, packed with SIMD victim search over dense frequencies: 1")
+            ("cache.warm_tier_budget", boost::program_options::value<std::size_t>(&d.warm_tier_budget)->default_value(0), "bytes for evicted entries kept packed before the items file, 0 disabled")
+            ("cache.mrc_sample_rate", boost::program_options::value<double>(&d.mrc_sample_rate)->default_value(0), "fraction of keys profiled for the miss ratio curve e.g 0.01, 0 disabled")
+            ("cache.perf_counters", boost::program_options::value<short>(&d.perf_counters)->default_value(0), "count cycles/instructions/cache, dTLB and branch misses of Get, Put, eviction and Flush with perf_event_open and print them per operation: 1, off: 0")
+            ("cache.trace_events", boost::program_options::value<short>(&d.trace_events)->default_value(0), "record evictions, flushes, items file writes/syncs, lock waits and CAS back offs per thread from start: 1, off until switched on: 0")
+            ("cache.trace_file", boost::program_options::value<std::string>(&d.trace_file)->default_value(""), "write the recorded events as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) here on exit, empty do not write")
+            ("cache.mrc_trace", boost::program_options::value<std::string>(&d.mrc_trace)->default_value(""), "print the miss ratio curve of this trace (a key first on every line) and exit, empty normal run")
             ("cache.reader_file", boost::program_options::value<std::string>(&d.reader_file_name)->default_value("../InMemoryCacheForCpp/res/reader_file.txt"), "reader file path+name")
             ("cache.writer_file", boost::program_options::value<std::string>(&d.writer_file_name)->default_value("../InMemoryCacheForCpp/res/writer_file.txt"), "writer file path+name")
+            ("cache.writer_appliers", boost::program_options::value<std::size_t>(&d.writer_appliers)->default_value(0), "threads applying parsed writes fed through lock free rings, keys sharded over them, 0 parser threads Put themselves")
             ("cache.items_file", boost::program_options::value<std::string>(&d.items_file_name)->default_value("../InMemoryCacheForCpp/res/item_file.txt"), "item file to write to")
+            ("cache.key_type", boost::program_options::value<short>(&d.key_type)->default_value(0), "key type short (line numbered items file): 0, 64 bit integer: 1, string: 2")
             ("cache.stratergy", boost::program_options::value<short>(&d.stratergy)->default_value(0), "Choose Cache Algorithm LFU: 0, LRU: 1")
-            ("cache.cache_timeout", boost::program_options::value<int>(&d.cache_timeout)->default_value(5), "Choose Cache Algorithm LFU: 0, LRU: 1")
+            ("cache.cache_timeout", boost::program_options::value<int>(&d.cache_timeout)->default_value(5), "seconds between writeback thread passes")
+            ("cache.delayed_write_timeout", boost::program_options::value<int>(&d.delayed_write_timeout)->default_value(0), "seconds a buffer may stay dirty before a writeback pass writes it")
+            ("cache.dirty_ratio", boost::program_options::value<short>(&d.dirty_ratio)->default_value(0), "percent of dirty buffers that wakes writeback early, 0 never")
+            ("cache.write_mode", boost::program_options::value<short>(&d.write_mode)->default_value(0), "Put leaves buffer dirty for writeback: 0, writes the items file right away: 1, writes the items file without caching: 2")
+            ("cache.writeback_rate", boost::program_options::value<std::size_t>(&d.writeback_rate)->default_value(0), "buffers written back per second at most, 0 unlimited")
+            ("cache.default_ttl", boost::program_options::value<int>(&d.default_ttl)->default_value(0), "seconds an entry lives in cache when Put without TTL, 0 never expires")
+            ("cache.readahead", boost::program_options::value<std::size_t>(&d.readahead)->default_value(0), "keys prefetched ahead of a detected sequential/strided stream, 0 disabled")
+            ("cache.frequency_decay_period", boost::program_options::value<int>(&d.frequency_decay_period)->default_value(0), "seconds between halving LFU frequencies, 0 never")
+            ("cache.thread_placement", boost::program_options::value<std::string>(&d.thread_placement)->default_value("compact"), "pin reader/writer threads: compact, spread, per_node or explicit")
+            ("cache.reader_cpus", boost::program_options::value<std::string>(&d.reader_cpus)->default_value(""), "cpu list for readers with explicit placement e.g 1,3,5-7")
+            ("cache.writer_cpus", boost::program_options::value<std::string>(&d.writer_cpus)->default_value(""), "cpu list for writers with explicit placement e.g 0,2,4")
+            ("cache.server_port", boost::program_options::value<uint16_t>(&d.server_port)->default_value(0), "serve memcached text protocol on this loopback port instead of reader/writer files, 0 file mode")
+            ("cache.server_threads", boost::program_options::value<std::size_t>(&d.server_threads)->default_value(0), "reactor threads of the server, 0 one per cpu")
+            ("cache.shared_memory_name", boost::program_options::value<std::string>(&d.shared_memory_name)->default_value(""), "attach to the cache in this shared memory segment (cmake -DUSING_BOOST_IPC=ON, short keys), empty per process cache")
             ("cache.run_test", boost::program_options::value<short>(&d.run_test)->default_value(0), "choose to run test");
     });
 
@@ -68,48 +246,29 @@ int main(int argc, char *argv[])
     }
     //std::cout << config;
 
-    if (!config.data().run_test){
-
-        // using redis-client key/value storage(opensource) or boost::multi_index_container will give  better performance
-        auto cache_manager = std::make_shared<CacheManager<short, double, std::unordered_map>>(config);
-
-        auto start = std::chrono::high_resolution_clock::now();
+    if (config.data().run_test){
 
-        auto w = std::make_unique<Writer<double>>(cache_manager->Self());
-        auto r = std::make_unique<Reader<double>>(cache_manager->Self());
-        auto func_writer = [&w](){
+        // exit status tells a CI job whether every test passed
+        return RunGTest(argc, argv);
+    }else if (!config.data().mrc_trace.empty()){
 
-            std::cout << "Excecuting Writer.." << std::endl;
-            w->execute();
-        };
-        std::thread wt(func_writer);
-        auto func_reader = [&r](){
+        switch(config.data().key_type){
 
-            std::cout << "Excecuting Reader.." << std::endl;
-            r->execute();
-        };
-        std::thread rt(func_reader);
+            case 1: RunMissRatioCurve<std::int64_t>(config); break;
+            case 2: RunMissRatioCurve<StringKey>(config); break;
+            default: RunMissRatioCurve<short>(config); break;
+        }
+    }else if (config.data().server_port){
 
-        rt.join();
-        wt.join();
-
-        std::unique_lock locker(gCheckProgramExit);
-        gCheckProgramExitConVar.wait_for(locker, 10s, []()mutable {
-
-            int c = Command::mCurrThreadsAlive.load(std::memory_order_acquire);
-            return (!c);
-        });
-
-        w.reset();
-        r.reset();
-
-        auto end = std::chrono::high_resolution_clock::now();
-
-        std::chrono::duration<double> diff = end-start;
-        std::cout << "Time to Complete: " << diff.count() << std::endl;
+        RunServer(config);
     }else{
 
-        RunGTest(argc, argv);
+        switch(config.data().key_type){
+
+            case 1: RunCache<std::int64_t>(config); break;
+            case 2: RunCache<StringKey>(config); break;
+            default: RunCache<short>(config); break;
+        }
     }
 
     return 0;
@@ -0,0 +1,146 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+
+#ifndef MPMC_RING_H
+#define MPMC_RING_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+/*
+ * Bounded lock free multi producer multi consumer ring (Vyukov). Every cell carries a sequence number
+ * telling whose turn it is, producers and consumers only CAS their own position so neither side ever
+ * waits on a lock, a full ring fails TryPush and an empty one TryPop and the caller picks how to back off.
+ *  # - capacity is rounded up to a power of two
+ *  # - cells are one cache line each so neighbouring producers/consumers do not false share
+*/
+template<typename T>
+class MpmcRing
+{
+    struct alignas(64) Cell{
+
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+public:
+    explicit MpmcRing(std::size_t p_Capacity)
+        :mMask(RoundUp(p_Capacity) - 1), mCells(new Cell[mMask + 1]){
+
+        for (std::size_t i = 0; i <= mMask; ++i)
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    /*
+     * @brief       move p_Value into the ring
+     *
+     * @return      false if the ring is full, p_Value is left untouched then
+    */
+    bool TryPush(T& p_Value){
+
+        Cell* cell;
+        std::size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+        for (;;){
+
+            cell = &mCells[position & mMask];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (difference == 0){
+
+                if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }else if (difference < 0){
+
+                // consumer of the previous lap has not emptied this cell yet
+                return false;
+            }else{
+
+                position = mEnqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(p_Value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*
+     * @brief       move the oldest value out of the ring into p_Value
+     *
+     * @return      false if the ring is empty
+    */
+    bool TryPop(T& p_Value){
+
+        Cell* cell;
+        std::size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+        for (;;){
+
+            cell = &mCells[position & mMask];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+            if (difference == 0){
+
+                if (mDequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }else if (difference < 0){
+
+                return false;
+            }else{
+
+                position = mDequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        p_Value = std::move(cell->value);
+        // hand the cell to the producer of the next lap
+        cell->sequence.store(position + mMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t Capacity() const{
+
+        return mMask + 1;
+    }
+
+private:
+    static std::size_t RoundUp(std::size_t p_Capacity){
+
+        std::size_t capacity = 2;
+        while (capacity < p_Capacity)
+            capacity <<= 1;
+        return capacity;
+    }
+
+private:
+    const std::size_t mMask;
+    std::unique_ptr<Cell[]> mCells;
+    alignas(64) std::atomic<std::size_t> mEnqueuePosition{0};
+    alignas(64) std::atomic<std::size_t> mDequeuePosition{0};
+};
+
+#endif // MPMC_RING_H
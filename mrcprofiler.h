@@ -0,0 +1,242 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+
+#ifndef MRC_PROFILER_H
+#define MRC_PROFILER_H
+
+#include <map>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include "utilstructs.h"
+
+/*
+ * Miss ratio curve estimation with SHARDS (Waldspurger et al., FAST'15): Mattson stack distances of a
+ * spatially hashed sample of the keys, scaled by the sampling rate, give the hit ratio of an LRU cache
+ * of every size from one pass. LRU is the usual proxy, LFU of this cache does at least as well on skewed loads.
+ *  # - a key is sampled if hash(key) mod P < T, rate R = T / P, the check is lock free so accesses
+ *      of keys that are not sampled write nothing shared
+ *  # - stack distance of a sampled access is the number of distinct sampled keys used since the last
+ *      access of that key, counted with a Fenwick tree over access times
+ *  # - at most mMaxKeys keys are tracked, beyond that the key with the biggest hash is dropped and T lowered
+ *      to it (fixed size SHARDS) so memory stays bounded on any key space
+*/
+template<typename Key>
+class ShardsProfiler
+{
+public:
+    static constexpr uint64_t mModulus = uint64_t(1) << 24;                  //P
+    static constexpr std::size_t mBuckets = 1024;                           //histogram of scaled distances
+    static constexpr std::array<double, 9> mCapacityFactors{0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 2.5, 3.0, 4.0};
+
+    /*
+     * p_CacheSize sets the histogram range (8 times of it so the curve still covers 4x after growing 2x),
+     * p_SampleRate is R (1 profiles every key), p_MaxKeys bounds the keys tracked
+    */
+    ShardsProfiler(std::size_t p_CacheSize, double p_SampleRate, std::size_t p_MaxKeys = 8192)
+        :mThreshold(static_cast<uint64_t>(std::clamp(p_SampleRate, 0.0, 1.0) * mModulus)), mMaxKeys(std::max<std::size_t>(p_MaxKeys, 1)),
+          mBucketWidth(std::max<std::size_t>(1, (8 * std::max<std::size_t>(p_CacheSize, 1) + mBuckets - 1) / mBuckets)),
+          mTree(4 * mMaxKeys + 1, 0){
+
+        mHistogram.fill(0);
+    }
+
+    ShardsProfiler(const ShardsProfiler&) = delete;
+    ShardsProfiler& operator=(const ShardsProfiler&) = delete;
+
+    bool Sampled(const Key& p_Key) const{
+
+        return (Mix(p_Key) % mModulus) < mThreshold.load(std::memory_order_relaxed);
+    }
+
+    /*
+     * @brief       account one reference of p_Key, only sampled keys take the profiler lock
+     *
+     * @return      void
+    */
+    void Access(const Key& p_Key){
+
+        const uint64_t hash = Mix(p_Key) % mModulus;
+        if (hash >= mThreshold.load(std::memory_order_relaxed))
+            return;
+
+        std::lock_guard lk(mGuard);
+        // threshold may have been lowered while waiting
+        if (hash >= mThreshold.load(std::memory_order_relaxed))
+            return;
+
+        if (mTime + 1 == mTree.size())
+            Compact();
+        // every sampled reference stands for 1/R references at the rate it was taken (rate only goes down)
+        const double rate = SampleRate();
+        mSampledReferences++;
+        mReferences += 1 / rate;
+        auto itr = mLastAccess.find(p_Key);
+        if (itr == mLastAccess.end()){
+
+            mLastAccess.emplace(p_Key, mTime);
+            mByHash.emplace(hash, p_Key);
+        }else{
+
+            // distinct keys used after the last access of this one
+            const std::size_t last = itr->second;
+            const std::size_t distance = Prefix(mTime) - Prefix(last + 1);
+            const std::size_t scaled = static_cast<std::size_t>(distance / rate);
+            const std::size_t bucket = scaled / mBucketWidth;
+            // beyond the histogram is a miss at every size reported
+            if (bucket < mBuckets)
+                mHistogram[bucket] += 1 / rate;
+            Add(last + 1, -1);
+            itr->second = mTime;
+        }
+        Add(mTime + 1, 1);
+        mTime++;
+
+        if (mLastAccess.size() > mMaxKeys)
+            DropBiggestHash();
+    }
+
+    /*
+     * @brief       estimated hit ratio at mCapacityFactors times p_CacheSize
+     *
+     * @return      curve, empty points before the first sampled reference
+    */
+    MissRatioCurve Curve(std::size_t p_CacheSize) const{
+
+        std::lock_guard lk(mGuard);
+        MissRatioCurve curve;
+        curve.sampleRate = SampleRate();
+        curve.sampledReferences = mSampledReferences;
+        curve.trackedKeys = mLastAccess.size();
+        if (mSampledReferences == 0)
+            return curve;
+
+        for (const double factor : mCapacityFactors){
+
+            const std::size_t capacity = std::max<std::size_t>(1, static_cast<std::size_t>(factor * p_CacheSize));
+            curve.points.push_back({capacity, HitsBelow(capacity) / mReferences});
+        }
+        return curve;
+    }
+
+    double SampleRate() const{
+
+        return static_cast<double>(mThreshold.load(std::memory_order_relaxed)) / mModulus;
+    }
+
+private:
+    // keys like short hash to themselves, mix so the sample is spread over the key space
+    static uint64_t Mix(const Key& p_Key){
+
+        uint64_t x = static_cast<uint64_t>(std::hash<Key>{}(p_Key)) + 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    // caller must hold mGuard, accesses with scaled distance below p_Capacity hit, partial bucket interpolated
+    double HitsBelow(std::size_t p_Capacity) const{
+
+        double hits = 0;
+        const std::size_t full = std::min(mBuckets, p_Capacity / mBucketWidth);
+        for (std::size_t i = 0; i < full; ++i)
+            hits += mHistogram[i];
+        if (full < mBuckets)
+            hits += mHistogram[full] * static_cast<double>(p_Capacity % mBucketWidth) / mBucketWidth;
+        return hits;
+    }
+
+    // Fenwick tree, 1 based, a 1 at the position of the last access of every tracked key
+    void Add(std::size_t p_Position, int p_Delta){
+
+        for (; p_Position < mTree.size(); p_Position += p_Position & (~p_Position + 1))
+            mTree[p_Position] += p_Delta;
+    }
+
+    // marks at positions 1..p_Position
+    std::size_t Prefix(std::size_t p_Position) const{
+
+        int64_t sum = 0;
+        for (; p_Position > 0; p_Position -= p_Position & (~p_Position + 1))
+            sum += mTree[p_Position];
+        return static_cast<std::size_t>(sum);
+    }
+
+    // caller must hold mGuard, renumber last access times 0..n-1 keeping their order once time runs out
+    void Compact(){
+
+        std::vector<std::pair<std::size_t, const Key*>> order;
+        order.reserve(mLastAccess.size());
+        for (const auto& [key, time] : mLastAccess)
+            order.emplace_back(time, &key);
+        std::sort(order.begin(), order.end(), [](const auto& lhs, const auto& rhs){ return lhs.first < rhs.first; });
+
+        std::fill(mTree.begin(), mTree.end(), 0);
+        mTime = 0;
+        for (const auto& [time, key] : order){
+
+            mLastAccess[*key] = mTime;
+            Add(mTime + 1, 1);
+            mTime++;
+        }
+    }
+
+    // caller must hold mGuard, the biggest hash becomes T so it and every key sharing it are not sampled any more
+    void DropBiggestHash(){
+
+        const uint64_t threshold = std::prev(mByHash.end())->first;
+        mThreshold.store(threshold, std::memory_order_relaxed);
+        while (!mByHash.empty() && std::prev(mByHash.end())->first >= threshold){
+
+            auto last = std::prev(mByHash.end());
+            auto itr = mLastAccess.find(last->second);
+            Add(itr->second + 1, -1);
+            mLastAccess.erase(itr);
+            mByHash.erase(last);
+        }
+    }
+
+private:
+    std::atomic<uint64_t> mThreshold;                                   //T
+    const std::size_t mMaxKeys;
+    const std::size_t mBucketWidth;
+    std::vector<int32_t> mTree;
+    std::size_t mTime = 0;
+    std::unordered_map<Key, std::size_t> mLastAccess;                   //sampled key -> time of last access
+    std::multimap<uint64_t, Key> mByHash;
+    std::array<double, mBuckets> mHistogram;               //references by scaled stack distance
+    std::size_t mSampledReferences = 0;
+    double mReferences = 0;                                 //estimated references of the whole key space
+    mutable std::mutex mGuard;
+};
+
+#endif // MRC_PROFILER_H
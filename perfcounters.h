@@ -0,0 +1,247 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "utilstructs.h"
+
+/*
+ * Hardware counters of the calling thread through perf_event_open, one group so a single read()
+ * returns all of them consistently. Only user space is counted (exclude_kernel) which is what
+ * perf_event_paranoid 2 still allows. Every event is opened on its own terms, the ones the PMU or
+ * a container refuses (EACCES, ENOENT, no PMU in the VM) are left out and reported unavailable,
+ * wall time is always measured.
+*/
+class PerfEventGroup
+{
+public:
+    PerfEventGroup(){
+
+        mIndexOf.fill(NOT_OPEN);
+        for (int event = 0; event < (int)PERF_EVENT::MAX_EVENT; ++event){
+
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            Describe(static_cast<PERF_EVENT>(event), attr);
+            attr.disabled = (mLeader < 0);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            const int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, mLeader, 0));
+            if (fd < 0)
+                continue;
+            if (mLeader < 0)
+                mLeader = fd;
+            mIndexOf[event] = mOpened;
+            mFds[mOpened++] = fd;
+            mAvailable |= (1u << event);
+        }
+        if (mLeader >= 0)
+            ::ioctl(mLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    PerfEventGroup(const PerfEventGroup&) = delete;
+    PerfEventGroup& operator=(const PerfEventGroup&) = delete;
+
+    ~PerfEventGroup(){
+
+        for (int i = 0; i < mOpened; ++i)
+            ::close(mFds[i]);
+    }
+
+    // bit per PERF_EVENT that is counted
+    uint32_t AvailableEvents() const{
+
+        return mAvailable;
+    }
+
+    /*
+     * @brief       current counter values, how long the group was enabled and actually on the PMU,
+     *              and steady clock. unavailable events and a group that never got scheduled read 0
+     *
+     * @return      void
+    */
+    void Read(PerfReading& p_Reading) const{
+
+        p_Reading.nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                          std::chrono::steady_clock::now().time_since_epoch()).count());
+        p_Reading.enabled = p_Reading.running = 0;
+        p_Reading.counts.fill(0);
+        if (mLeader < 0)
+            return;
+
+        // number of events, time enabled, time running then the values in the order they joined
+        uint64_t values[3 + (int)PERF_EVENT::MAX_EVENT] = {};
+        if (::read(mLeader, values, sizeof(values)) < (ssize_t)(3 * sizeof(uint64_t)))
+            return;
+        p_Reading.enabled = values[1];
+        p_Reading.running = values[2];
+        for (int event = 0; event < (int)PERF_EVENT::MAX_EVENT; ++event)
+            if (mIndexOf[event] != NOT_OPEN && (uint64_t)mIndexOf[event] < values[0])
+                p_Reading.counts[event] = values[3 + mIndexOf[event]];
+    }
+
+private:
+    static void Describe(PERF_EVENT p_Event, perf_event_attr& p_Attr){
+
+        auto cache_miss = [&p_Attr](uint64_t p_Cache){
+
+            p_Attr.type = PERF_TYPE_HW_CACHE;
+            p_Attr.config = p_Cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        p_Attr.type = PERF_TYPE_HARDWARE;
+        switch (p_Event){
+
+            case PERF_EVENT::CYCLES: p_Attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case PERF_EVENT::INSTRUCTIONS: p_Attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case PERF_EVENT::L1D_MISSES: cache_miss(PERF_COUNT_HW_CACHE_L1D); break;
+            case PERF_EVENT::LLC_MISSES: cache_miss(PERF_COUNT_HW_CACHE_LL); break;
+            case PERF_EVENT::DTLB_MISSES: cache_miss(PERF_COUNT_HW_CACHE_DTLB); break;
+            case PERF_EVENT::BRANCH_MISSES: p_Attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+            default: break;
+        }
+    }
+
+private:
+    static constexpr int NOT_OPEN = -1;
+    int mLeader = -1;
+    int mOpened = 0;
+    uint32_t mAvailable = 0;
+    std::array<int, (int)PERF_EVENT::MAX_EVENT> mFds{};
+    std::array<int, (int)PERF_EVENT::MAX_EVENT> mIndexOf;                //position in the group read
+};
+
+/*
+ * Per operation totals of the counters, each thread reads its own group around the operation
+ * and adds the difference. Nested operations (an eviction inside a Get) count in both.
+*/
+class PerfCounters
+{
+public:
+    class Measurement
+    {
+    public:
+        // null p_Counters measures nothing, the disabled case costs a branch
+        Measurement(PerfCounters* p_Counters, PERF_OPERATION p_Operation)
+            :mCounters(p_Counters), mOperation(p_Operation){
+
+            if (mCounters)
+                ThreadGroup().Read(mStart);
+        }
+
+        Measurement(const Measurement&) = delete;
+        Measurement& operator=(const Measurement&) = delete;
+
+        ~Measurement(){
+
+            if (!mCounters)
+                return;
+            PerfReading end;
+            ThreadGroup().Read(end);
+            mCounters->Add(mOperation, mStart, end);
+        }
+
+    private:
+        PerfCounters* mCounters;
+        const PERF_OPERATION mOperation;
+        PerfReading mStart;
+    };
+
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // events the calling thread can count, 0 in most containers
+    static uint32_t AvailableEvents(){
+
+        return ThreadGroup().AvailableEvents();
+    }
+
+    PerfStats Statistics() const{
+
+        PerfStats stats;
+        stats.availableEvents = AvailableEvents();
+        for (int op = 0; op < (int)PERF_OPERATION::MAX_OPERATION; ++op){
+
+            const Totals& totals = mTotals[op];
+            PerfOperationStats& operation = stats.operations[op];
+            operation.operations = totals.operations.load(std::memory_order_relaxed);
+            operation.countedOperations = totals.countedOperations.load(std::memory_order_relaxed);
+            operation.nanoseconds = totals.nanoseconds.load(std::memory_order_relaxed);
+            for (int event = 0; event < (int)PERF_EVENT::MAX_EVENT; ++event)
+                operation.events[event] = totals.events[event].load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+private:
+    // opened on first use by each thread, closed when it exits
+    static const PerfEventGroup& ThreadGroup(){
+
+        thread_local PerfEventGroup group;
+        return group;
+    }
+
+    void Add(PERF_OPERATION p_Operation, const PerfReading& p_Start, const PerfReading& p_End){
+
+        Totals& totals = mTotals[(int)p_Operation];
+        totals.operations.fetch_add(1, std::memory_order_relaxed);
+        totals.nanoseconds.fetch_add(p_End.nanoseconds - p_Start.nanoseconds, std::memory_order_relaxed);
+
+        // group off the PMU the whole time (no free counters, NMI watchdog) counted nothing, multiplexed is scaled up
+        const uint64_t running = p_End.running - p_Start.running;
+        if (running == 0)
+            return;
+        const double scale = static_cast<double>(p_End.enabled - p_Start.enabled) / running;
+        totals.countedOperations.fetch_add(1, std::memory_order_relaxed);
+        for (int event = 0; event < (int)PERF_EVENT::MAX_EVENT; ++event)
+            totals.events[event].fetch_add(static_cast<uint64_t>((p_End.counts[event] - p_Start.counts[event]) * scale), std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(64) Totals{
+
+        std::atomic<std::size_t> operations{0};
+        std::atomic<std::size_t> countedOperations{0};
+        std::atomic<uint64_t> nanoseconds{0};
+        std::array<std::atomic<uint64_t>, (int)PERF_EVENT::MAX_EVENT> events{};
+    };
+    std::array<Totals, (int)PERF_OPERATION::MAX_OPERATION> mTotals;
+};
+
+#endif // PERF_COUNTERS_H
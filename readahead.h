@@ -0,0 +1,172 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef READ_AHEAD_H
+#define READ_AHEAD_H
+
+#include <array>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+/*
+ * Range of keys a detected stream is expected to touch next: first, first + stride, ... count keys
+*/
+struct PrefetchWindow{
+
+    int64_t first = 0;
+    int64_t stride = 0;
+    std::size_t count = 0;
+};
+
+/*
+ * Detects sequential/strided misses of integral keys (reader files mostly ask ascending lines).
+ * Streams are tracked per shard, a thread always hashes to the same shard so a reader walking
+ * its file is not disturbed by the others. A stride seen twice in a row is a stream, from then
+ * on every access past the already prefetched part slides the window mDepth keys ahead.
+*/
+class StreamDetector
+{
+public:
+    static constexpr int64_t mMaxStride = 64;
+
+    explicit StreamDetector(std::size_t p_Depth = 0)
+        :mDepth(p_Depth){}
+
+    StreamDetector(const StreamDetector&) = delete;
+    StreamDetector& operator=(const StreamDetector&) = delete;
+
+    void SetDepth(std::size_t p_Depth){
+
+        mDepth = p_Depth;
+    }
+
+    std::size_t Depth() const{
+
+        return mDepth;
+    }
+
+    /*
+     * @brief       feed a demand miss (or first hit on a prefetched key) of this thread
+     *
+     * @return      true if p_Window holds keys worth prefetching
+    */
+    bool Observe(int64_t p_Key, PrefetchWindow& p_Window){
+
+        if (mDepth == 0)
+            return false;
+
+        Stream& stream = mStreams[std::hash<std::thread::id>{}(std::this_thread::get_id()) % mStreams.size()];
+        // never make the miss path wait, losing a sample only delays detection
+        std::unique_lock lk(stream.guard, std::try_to_lock);
+        if (!lk.owns_lock())
+            return false;
+
+        const int64_t delta = p_Key - stream.last;
+        stream.last = p_Key;
+        if (delta == 0 || delta != stream.stride){
+
+            stream.stride = (delta > -mMaxStride && delta < mMaxStride) ? delta : 0;
+            stream.confirmed = false;
+            return false;
+        }
+        if (!stream.confirmed){
+
+            stream.confirmed = true;
+            stream.prefetchedUntil = p_Key;
+        }
+
+        // only issue what is not already in flight, keep the window mDepth strides ahead
+        const int64_t window_end = p_Key + (stream.stride * static_cast<int64_t>(mDepth));
+        const int64_t first = stream.prefetchedUntil + stream.stride;
+        const std::size_t count = static_cast<std::size_t>((window_end - first) / stream.stride + 1);
+        if ((stream.stride > 0 && first > window_end) || (stream.stride < 0 && first < window_end))
+            return false;
+
+        p_Window = PrefetchWindow{first, stream.stride, count};
+        stream.prefetchedUntil = window_end;
+        return true;
+    }
+
+private:
+    struct Stream{
+
+        std::mutex guard;
+        int64_t last = 0;
+        int64_t stride = 0;
+        bool confirmed = false;
+        int64_t prefetchedUntil = 0;
+    };
+
+    std::size_t mDepth;
+    std::array<Stream, 16> mStreams;
+};
+
+/*
+ * Windows waiting to be loaded by the readahead thread, bounded so a burst of streams
+ * drops prefetches instead of queueing work that is stale by the time it runs
+*/
+class PrefetchQueue
+{
+public:
+    static constexpr std::size_t mMaxPending = 64;
+
+    void Push(const PrefetchWindow& p_Window){
+
+        {
+            std::lock_guard lk(mQueueGuard);
+            if (mPending.size() == mMaxPending)
+                return;
+            mPending.push_back(p_Window);
+        }
+        mQueueCondition.notify_one();
+    }
+
+    /*
+     * @brief       wait up to p_MaxWait for a window
+     *
+     * @return      true if p_Window was popped
+    */
+    bool Pop(PrefetchWindow& p_Window, std::chrono::milliseconds p_MaxWait){
+
+        std::unique_lock lk(mQueueGuard);
+        if (!mQueueCondition.wait_for(lk, p_MaxWait, [this](){ return !mPending.empty(); }))
+            return false;
+
+        p_Window = mPending.front();
+        mPending.pop_front();
+        return true;
+    }
+
+private:
+    std::deque<PrefetchWindow> mPending;
+    std::mutex mQueueGuard;
+    std::condition_variable mQueueCondition;
+};
+
+#endif // READ_AHEAD_H
@@ -0,0 +1,126 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef READ_BUFFER_H
+#define READ_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+/*
+ * Lossy striped buffer of cache hits (same idea as Caffeine read buffers).
+ * A hit only appends the buffer index to the ring of its thread's stripe, the policy
+ * applies them later in one go, so readers of a hot key never write its cache line.
+ *  # - full ring or a lost race on the tail drops the event, frequency is a heuristic anyway
+ *  # - Record returns true once a ring is full so the caller can drain without waiting for maintenance
+*/
+class ReadBuffer
+{
+public:
+    static constexpr std::size_t mNumberOfStripes = 16;
+    static constexpr uint32_t mRingSize = 32;                            //power of 2
+    static constexpr int32_t EMPTY_SLOT = -1;
+
+    ReadBuffer(){
+
+        for (auto& stripe : mStripes)
+            for (auto& slot : stripe.slots)
+                slot.store(EMPTY_SLOT, std::memory_order_relaxed);
+    }
+
+    ReadBuffer(const ReadBuffer&) = delete;
+    ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+    /*
+     * @brief       append p_Index to the ring of this thread
+     *
+     * @return      true if the ring is full and should be drained
+    */
+    bool Record(int32_t p_Index){
+
+        Stripe& stripe = mStripes[StripeOfThisThread()];
+        uint32_t tail = stripe.writeCount.load(std::memory_order_relaxed);
+        if (tail - stripe.readCount.load(std::memory_order_acquire) >= mRingSize)
+            return true;
+
+        // losing the race to another thread of the same stripe just drops this hit
+        if (stripe.writeCount.compare_exchange_strong(tail, tail + 1, std::memory_order_relaxed))
+            stripe.slots[tail & (mRingSize - 1)].store(p_Index, std::memory_order_release);
+        return false;
+    }
+
+    /*
+     * @brief       hand every recorded index to p_Apply, only one thread drains at a time
+     *              and a busy drain is skipped instead of waited for
+     *
+     * @return      number of events drained
+    */
+    template<typename Apply>
+    std::size_t Drain(Apply&& p_Apply){
+
+        std::unique_lock lk(mDrainGuard, std::try_to_lock);
+        if (!lk.owns_lock())
+            return 0;
+
+        std::size_t drained = 0;
+        for (auto& stripe : mStripes){
+
+            uint32_t head = stripe.readCount.load(std::memory_order_relaxed);
+            const uint32_t tail = stripe.writeCount.load(std::memory_order_acquire);
+            for (; head != tail; ++head){
+
+                // writer claimed the slot but did not store yet, pick it up next drain
+                const int32_t index = stripe.slots[head & (mRingSize - 1)].exchange(EMPTY_SLOT, std::memory_order_acquire);
+                if (index == EMPTY_SLOT)
+                    break;
+                p_Apply(index);
+                drained++;
+            }
+            stripe.readCount.store(head, std::memory_order_release);
+        }
+        return drained;
+    }
+
+private:
+    struct alignas(64) Stripe{
+
+        std::atomic<uint32_t> writeCount{0};
+        alignas(64) std::atomic<uint32_t> readCount{0};
+        std::array<std::atomic<int32_t>, mRingSize> slots;
+    };
+
+    static std::size_t StripeOfThisThread(){
+
+        static std::atomic<std::size_t> next_stripe{0};
+        static thread_local const std::size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % mNumberOfStripes;
+        return stripe;
+    }
+
+    std::array<Stripe, mNumberOfStripes> mStripes;
+    std::mutex mDrainGuard;
+};
+
+#endif // READ_BUFFER_H
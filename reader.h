@@ -35,14 +35,14 @@
 extern std::shared_mutex gCheckProgramExit;
 extern std::condition_variable_any gCheckProgramExitConVar;
 
-template<typename DATA>
+template<typename KEY, typename DATA, typename CACHE = CacheManager<KEY, DATA>>
 class Reader : public Command
 {
-    using key_type = typename CacheManager<short, DATA>::key_type;
-    using value_type = typename CacheManager<short, DATA>::value_type;
+    using key_type = typename CACHE::key_type;
+    using value_type = typename CACHE::value_type;
 
 public:
-    Reader(std::shared_ptr<CacheManager<short, DATA>> cache_manager)
+    Reader(std::shared_ptr<CACHE> cache_manager)
         :mCacheManager(cache_manager){}
 
     virtual ~Reader(){
@@ -63,29 +63,14 @@ public:
              * Using std::string_view to gurantee "Zero Copying" to yield better performance
             */
             std::string_view input_text(start_address);
-            std::regex r(R"(*)");
+            std::regex r(R"([^\n]+)");
             /*
              * raison d'être:
              * linux with fair scheduler will not let thread priority numbers
-             * So find out high clock speed cores and assign high priority task
-             * trick is divide task to run only in designated cores to avoid posibility
-             * of one task blocking other for longer period
+             * so threads are pinned as cache.thread_placement says, close to each other (compact),
+             * one per core (spread), per NUMA node or to explicit cpu lists
             */
-            std::once_flag flg;
-            cpu_set_t cpuset;
-            std::call_once(flg, [&cpuset](){
-
-                CPU_ZERO(&cpuset);
-                /*
-                 * Do hyper-threading for low latency as my i7 can support already with 4 core per processor.
-                 * CPU affinity:
-                 *  0,2, etc.. for writer
-                 *  1,3, etc.. fostartConsumerr reader
-                */
-                for(int cpu_index = 1; cpu_index < mMaxThreadAllowed; cpu_index += 2){
-
-                    CPU_SET(cpu_index,&cpuset);
-            }});
+            ThreadPlacement& placement = mCacheManager->Placement();
             for(std::cregex_iterator i = std::cregex_iterator(input_text.begin(), input_text.end(), r);
                 i != std::cregex_iterator();
                 ++i)
@@ -106,7 +91,7 @@ public:
                     continue;
                 }
                 std::thread t(std::move(task),f);
-                int rc = pthread_setaffinity_np(t.native_handle(),sizeof(cpu_set_t), &cpuset);
+                int rc = placement.Pin(t, THREAD_ROLE::READER);
                 if (rc != 0) {
 
                     std::cerr << "Error calling pthread_setaffinity_np: " << rc << std::endl;
@@ -139,20 +124,20 @@ public:
 
                 Outfile.open(out_filename,std::ofstream::out | std::ofstream::app);
             }
-            std::regex r(R"([^\W]+*)");
+            std::regex r(R"([^\s]+)");
             for(std::cregex_iterator i = std::cregex_iterator(input_text.begin(), input_text.end(), r);
                 i != std::cregex_iterator();
                 ++i)
             {
                 std::stringstream ss;
-                key_type line_number;
+                key_type key;
                 std::cmatch m = *i;
                 std::string temp = m.str();
                 if (temp.length() > 0){
 
                     try{
 
-                        line_number = boost::lexical_cast<key_type>(temp);
+                        key = KeyTraits<key_type>::Parse(temp);
 
                     }catch(boost::bad_lexical_cast &exp){
 
@@ -161,7 +146,7 @@ public:
                     }
                     value_type v;
                     //std::cout << __FUNCTION__ << "Check Point: 1" << std::endl;
-                    if (!mCacheManager->Get(line_number, v)){
+                    if (!mCacheManager->Get(key, v)){
 
                         ss << v << " Cache";
                     }else{
@@ -185,5 +170,5 @@ public:
     }
 
 private:
-    std::shared_ptr<CacheManager<short, DATA>> mCacheManager;
+    std::shared_ptr<CACHE> mCacheManager;
 };
@@ -0,0 +1,153 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+
+#ifndef READ_INDEX_H
+#define READ_INDEX_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <functional>
+
+#include "epoch.h"
+
+/*
+ * Key to buffer index map for the lock free Get hit path, kept next to the locked hash map.
+ * Chained hash table of immutable nodes: writers (serialized by the caller) link new nodes at the
+ * bucket head and unlink removed ones, readers walk the chains inside an EpochDomain::Guard so an
+ * unlinked node stays readable until EpochDomain reclaims it.
+ *  # - number of entries is bounded by the number of buffers, buckets are sized once for it
+ *  # - each node remembers the buffer version it was mapped with so a reader can tell the
+ *      buffer was evicted and reused after it found the node
+*/
+template<typename Key, typename Hash = std::hash<Key>>
+class ReadIndex
+{
+    struct Node{
+
+        const Key key;
+        const int32_t index;
+        const uint32_t version;
+        std::atomic<Node*> next;
+    };
+
+public:
+    static constexpr std::size_t mNodeBytes = sizeof(Node);                          //per mapped key
+    static constexpr std::size_t mBucketBytesPerEntry = 2 * sizeof(std::atomic<Node*>); //per possible key
+
+    explicit ReadIndex(std::size_t p_MaxEntries)
+        :mMask(BucketsFor(p_MaxEntries) - 1), mBuckets(new std::atomic<Node*>[mMask + 1]){
+
+        for (std::size_t i = 0; i <= mMask; ++i)
+            mBuckets[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ReadIndex(const ReadIndex&) = delete;
+    ReadIndex& operator=(const ReadIndex&) = delete;
+
+    ~ReadIndex(){
+
+        for (std::size_t i = 0; i <= mMask; ++i){
+
+            Node* node = mBuckets[i].load(std::memory_order_relaxed);
+            while (node){
+
+                Node* next = node->next.load(std::memory_order_relaxed);
+                delete node;
+                node = next;
+            }
+        }
+    }
+
+    /*
+     * @brief       reader side lookup, caller must be inside an epoch of EpochDomain::Global()
+     *
+     * @return      true if p_Key is mapped, p_Index/p_Version are the buffer and its version at mapping time
+    */
+    bool Find(const Key& p_Key, int32_t& p_Index, uint32_t& p_Version) const{
+
+        for (Node* node = mBuckets[Hash{}(p_Key) & mMask].load(std::memory_order_acquire); node;
+             node = node->next.load(std::memory_order_acquire)){
+
+            if (node->key == p_Key){
+
+                p_Index = node->index;
+                p_Version = node->version;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * @brief       map p_Key to buffer p_Index, writers must be serialized by the caller
+     *
+     * @return      void
+    */
+    void Insert(const Key& p_Key, int32_t p_Index, uint32_t p_Version){
+
+        Erase(p_Key);
+        std::atomic<Node*>& bucket = mBuckets[Hash{}(p_Key) & mMask];
+        Node* node = new Node{p_Key, p_Index, p_Version, {bucket.load(std::memory_order_relaxed)}};
+        bucket.store(node, std::memory_order_release);
+    }
+
+    /*
+     * @brief       unmap p_Key, the node is freed once no reader can hold it any more
+     *
+     * @return      true if p_Key was mapped
+    */
+    bool Erase(const Key& p_Key){
+
+        std::atomic<Node*>* link = &mBuckets[Hash{}(p_Key) & mMask];
+        for (Node* node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed)){
+
+            if (node->key == p_Key){
+
+                // readers standing on node still reach the rest of the chain through it
+                link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+                EpochDomain::Global().Retire([node](){ delete node; });
+                return true;
+            }
+            link = &node->next;
+        }
+        return false;
+    }
+
+private:
+    static std::size_t BucketsFor(std::size_t p_MaxEntries){
+
+        std::size_t buckets = 16;
+        while (buckets < 2 * p_MaxEntries)
+            buckets <<= 1;
+        return buckets;
+    }
+
+private:
+    const std::size_t mMask;
+    std::unique_ptr<std::atomic<Node*>[]> mBuckets;
+};
+
+#endif // READ_INDEX_H
@@ -0,0 +1,494 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef MEMCACHED_SERVER_H
+#define MEMCACHED_SERVER_H
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <charconv>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "command.h"
+#include "cachemanager.h"
+
+/*
+ * memcached text protocol front end so processes on this host can share the cache.
+ * Multi reactor: every reactor thread owns an epoll instance and its own SO_REUSEPORT listening
+ * socket on the loopback interface, kernel spreads new connections over them so reactors never
+ * share a connection. Requests are parsed in place from the per connection read buffer and
+ * replies appended to the per connection write buffer, both keep their capacity across requests.
+ *  # - get/gets <key>*, set <key> <flags> <exptime> <bytes> [noreply], delete <key> [noreply], trace on|off, version, quit
+ *  # - flags are kept in front of the value, exptime becomes the entry TTL, gets reports cas 0 (no cas command)
+ *  # - pipelined requests are all answered in order from one read
+*/
+template<typename KEY, typename DATA, typename CACHE = CacheManager<KEY, DATA>>
+class MemcachedServer : public Command
+{
+    static_assert(std::is_same_v<DATA, std::string>, "memcached values are byte strings");
+
+    using key_type = KEY;
+    using value_type = DATA;
+    using flags_type = uint32_t;
+
+public:
+    static constexpr std::size_t mMaxKeyLength = 250;
+    static constexpr std::size_t mMaxLineLength = 2048;
+    static constexpr std::size_t mInitialBufferSize = 16 * 1024;
+    static constexpr std::size_t mMaxValueLength = SlabAllocator::mMaxChunkSize - sizeof(flags_type);
+
+    MemcachedServer(std::shared_ptr<CACHE> p_Cache, uint16_t p_Port, std::size_t p_NumberOfReactors)
+        :mCache(p_Cache), mPort(p_Port), mReactors(std::max<std::size_t>(1, p_NumberOfReactors)){
+
+        // a key past its exptime must miss, not come back from the items file
+        mCache->SetExpiryRemoves(true);
+    }
+
+    MemcachedServer(const MemcachedServer&) = delete;
+    MemcachedServer& operator=(const MemcachedServer&) = delete;
+
+    virtual ~MemcachedServer(){
+
+        Stop();
+        for (auto& reactor : mReactors){
+
+            for (auto& [fd, connection] : reactor.connections)
+                ::close(fd);
+            if (reactor.listenFd >= 0)
+                ::close(reactor.listenFd);
+            if (reactor.epollFd >= 0)
+                ::close(reactor.epollFd);
+        }
+    }
+
+    /*
+     * @brief       open a listening socket and epoll instance per reactor
+     *              port 0 picks a free port shared by all reactors, see Port()
+     *
+     * @return      void, throws std::system_error on failure
+    */
+    void Listen(){
+
+        for (auto& reactor : mReactors){
+
+            reactor.listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (reactor.listenFd < 0)
+                throw std::system_error(errno, std::generic_category(), "socket");
+
+            int on = 1;
+            ::setsockopt(reactor.listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            ::setsockopt(reactor.listenFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(mPort);
+            if (::bind(reactor.listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+                throw std::system_error(errno, std::generic_category(), "bind");
+            if (::listen(reactor.listenFd, SOMAXCONN) < 0)
+                throw std::system_error(errno, std::generic_category(), "listen");
+
+            // rest of the reactors join the port the first one got
+            socklen_t length = sizeof(address);
+            ::getsockname(reactor.listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+            mPort = ntohs(address.sin_port);
+
+            reactor.epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+            if (reactor.epollFd < 0)
+                throw std::system_error(errno, std::generic_category(), "epoll_create1");
+            Watch(reactor, reactor.listenFd, EPOLLIN, EPOLL_CTL_ADD);
+        }
+        mListening = true;
+    }
+
+    /*
+     * @brief       serve until Stop(), reactor 0 runs on the calling thread
+     *
+     * @return      void
+    */
+    void execute(){
+
+        try{
+
+            if (!mListening)
+                Listen();
+        }catch(std::exception &exp){
+
+            std::cout << "server failed to listen on port " << mPort << " exp: " << exp.what() << std::endl;
+            return;
+        }
+        std::cout << "Serving memcached protocol on 127.0.0.1:" << mPort << " reactors: " << mReactors.size() << std::endl;
+
+        std::vector<std::thread> reactor_threads;
+        for (std::size_t i = 1; i < mReactors.size(); ++i)
+            reactor_threads.emplace_back(&MemcachedServer::RunReactor, this, std::ref(mReactors[i]));
+        RunReactor(mReactors[0]);
+        for (auto& reactor_thread : reactor_threads)
+            reactor_thread.join();
+    }
+
+    void Stop(){
+
+        mStopped.store(true, std::memory_order_release);
+    }
+
+    uint16_t Port() const{
+
+        return mPort;
+    }
+
+private:
+    struct Connection{
+
+        std::vector<char> in = std::vector<char>(mInitialBufferSize);
+        std::size_t inBegin = 0;
+        std::size_t inEnd = 0;
+        std::string out;
+        std::size_t outSent = 0;
+        value_type value;                       //Lookup target and set scratch, reused
+        bool closing = false;
+        bool watchingWrites = false;
+    };
+
+    struct Reactor{
+
+        int epollFd = -1;
+        int listenFd = -1;
+        std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    };
+
+    static void Watch(Reactor& p_Reactor, int p_Fd, uint32_t p_Events, int p_Operation){
+
+        epoll_event event{};
+        event.events = p_Events;
+        event.data.fd = p_Fd;
+        ::epoll_ctl(p_Reactor.epollFd, p_Operation, p_Fd, &event);
+    }
+
+    void RunReactor(Reactor& p_Reactor){
+
+        epoll_event events[64];
+        while (!mStopped.load(std::memory_order_acquire)){
+
+            // wake up regularly to notice Stop()
+            const int ready = ::epoll_wait(p_Reactor.epollFd, events, 64, 100);
+            for (int i = 0; i < ready; ++i){
+
+                const int fd = events[i].data.fd;
+                if (fd == p_Reactor.listenFd){
+
+                    Accept(p_Reactor);
+                    continue;
+                }
+
+                auto itr = p_Reactor.connections.find(fd);
+                if (itr == p_Reactor.connections.end())
+                    continue;
+                Connection& connection = *itr->second;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    OnReadable(fd, connection);
+                // a connection about to close still gets its error reply, best effort
+                Send(p_Reactor, fd, connection);
+                if (connection.closing){
+
+                    ::close(fd);
+                    p_Reactor.connections.erase(itr);
+                }
+            }
+        }
+    }
+
+    void Accept(Reactor& p_Reactor){
+
+        for (;;){
+
+            const int fd = ::accept4(p_Reactor.listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return;
+
+            int on = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            p_Reactor.connections[fd] = std::make_unique<Connection>();
+            Watch(p_Reactor, fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+        }
+    }
+
+    void OnReadable(int p_Fd, Connection& p_Connection){
+
+        // make room, compact consumed bytes first and grow only for a value bigger than the buffer
+        if (p_Connection.inEnd == p_Connection.in.size()){
+
+            if (p_Connection.inBegin > 0){
+
+                std::memmove(p_Connection.in.data(), p_Connection.in.data() + p_Connection.inBegin, p_Connection.inEnd - p_Connection.inBegin);
+                p_Connection.inEnd -= p_Connection.inBegin;
+                p_Connection.inBegin = 0;
+            }else{
+
+                p_Connection.in.resize(p_Connection.in.size() * 2);
+            }
+        }
+
+        const ssize_t received = ::recv(p_Fd, p_Connection.in.data() + p_Connection.inEnd, p_Connection.in.size() - p_Connection.inEnd, 0);
+        if (received <= 0){
+
+            if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                p_Connection.closing = true;
+            return;
+        }
+        p_Connection.inEnd += received;
+
+        while (!p_Connection.closing && Process(p_Connection));
+        if (p_Connection.inBegin == p_Connection.inEnd)
+            p_Connection.inBegin = p_Connection.inEnd = 0;
+    }
+
+    void Send(Reactor& p_Reactor, int p_Fd, Connection& p_Connection){
+
+        while (p_Connection.outSent < p_Connection.out.size()){
+
+            const ssize_t sent = ::send(p_Fd, p_Connection.out.data() + p_Connection.outSent,
+                                        p_Connection.out.size() - p_Connection.outSent, MSG_NOSIGNAL);
+            if (sent < 0){
+
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                p_Connection.closing = true;
+                return;
+            }
+            p_Connection.outSent += sent;
+        }
+
+        const bool pending = (p_Connection.outSent < p_Connection.out.size());
+        if (!pending){
+
+            // keep the capacity for the next replies
+            p_Connection.out.clear();
+            p_Connection.outSent = 0;
+        }
+        if (pending != p_Connection.watchingWrites){
+
+            Watch(p_Reactor, p_Fd, EPOLLIN | EPOLLRDHUP | (pending ? (uint32_t)EPOLLOUT : 0u), EPOLL_CTL_MOD);
+            p_Connection.watchingWrites = pending;
+        }
+    }
+
+    static std::string_view NextToken(std::string_view& p_Line){
+
+        const std::size_t begin = p_Line.find_first_not_of(' ');
+        if (begin == std::string_view::npos){
+
+            p_Line = {};
+            return {};
+        }
+        p_Line.remove_prefix(begin);
+        const std::size_t end = std::min(p_Line.find(' '), p_Line.size());
+        std::string_view token = p_Line.substr(0, end);
+        p_Line.remove_prefix(end);
+        return token;
+    }
+
+    template<typename Number>
+    static bool ParseNumber(std::string_view p_Token, Number& p_Number){
+
+        const auto [ptr, ec] = std::from_chars(p_Token.data(), p_Token.data() + p_Token.size(), p_Number);
+        return (!p_Token.empty() && ec == std::errc() && ptr == p_Token.data() + p_Token.size());
+    }
+
+    /*
+     * @brief       answer the request at the front of the read buffer
+     *
+     * @return      false if the request is not complete yet
+    */
+    bool Process(Connection& p_Connection){
+
+        const char* data = p_Connection.in.data() + p_Connection.inBegin;
+        const std::size_t available = p_Connection.inEnd - p_Connection.inBegin;
+        const char* newline = static_cast<const char*>(std::memchr(data, '\n', available));
+        if (newline == nullptr){
+
+            if (available > mMaxLineLength){
+
+                p_Connection.out.append("CLIENT_ERROR line too long\r\n");
+                p_Connection.closing = true;
+            }
+            return false;
+        }
+
+        const std::size_t line_length = newline - data + 1;
+        std::string_view line(data, line_length - 1);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        const std::string_view command = NextToken(line);
+        if (command == "get" || command == "gets"){
+
+            for (std::string_view key = NextToken(line); !key.empty(); key = NextToken(line))
+                AppendValue(p_Connection, key, command == "gets");
+            p_Connection.out.append("END\r\n");
+        }else if (command == "set"){
+
+            const std::string_view key = NextToken(line);
+            flags_type flags;
+            long expiry;
+            std::size_t length;
+            if (key.empty() || key.size() > mMaxKeyLength || !ParseNumber(NextToken(line), flags) ||
+                    !ParseNumber(NextToken(line), expiry) || !ParseNumber(NextToken(line), length)){
+
+                p_Connection.out.append("CLIENT_ERROR bad command line format\r\n");
+                p_Connection.inBegin += line_length;
+                return true;
+            }
+            const bool no_reply = (NextToken(line) == "noreply");
+
+            // refused before buffering it, the data block that follows can not be framed so the connection goes
+            if (length > mMaxValueLength){
+
+                p_Connection.out.append("SERVER_ERROR object too large for cache\r\n");
+                p_Connection.inBegin += line_length;
+                p_Connection.closing = true;
+                return true;
+            }
+
+            // data block and its \r\n must be there as well
+            if (available < line_length + length + 2)
+                return false;
+            if (data[line_length + length] != '\r' || data[line_length + length + 1] != '\n'){
+
+                p_Connection.out.append("CLIENT_ERROR bad data chunk\r\n");
+                p_Connection.inBegin += line_length;
+                p_Connection.closing = true;
+                return true;
+            }
+            const std::string_view payload(data + line_length, length);
+            p_Connection.inBegin += line_length + length + 2;
+            const std::string_view reply = Store(p_Connection, key, flags, expiry, payload);
+            if (!no_reply)
+                p_Connection.out.append(reply);
+            return true;
+        }else if (command == "delete"){
+
+            const std::string_view key = NextToken(line);
+            const bool no_reply = (NextToken(line) == "noreply");
+            const bool deleted = (!key.empty() && key.size() <= mMaxKeyLength && mCache->Remove(KeyTraits<key_type>::Parse(key)));
+            if (!no_reply)
+                p_Connection.out.append(deleted ? "DELETED\r\n" : "NOT_FOUND\r\n");
+        }else if (command == "trace"){
+
+            // event tracer switch, the trace is written on exit to cache.trace_file
+            const std::string_view state = NextToken(line);
+            if (state == "on" || state == "off"){
+
+                EventTracer::Instance().Enable(state == "on");
+                p_Connection.out.append("OK\r\n");
+            }else{
+
+                p_Connection.out.append("CLIENT_ERROR trace on|off\r\n");
+            }
+        }else if (command == "version"){
+
+            p_Connection.out.append("VERSION lock_free_cache\r\n");
+        }else if (command == "quit"){
+
+            p_Connection.closing = true;
+        }else{
+
+            p_Connection.out.append("ERROR\r\n");
+        }
+
+        p_Connection.inBegin += line_length;
+        return true;
+    }
+
+    void AppendValue(Connection& p_Connection, std::string_view p_Key, bool p_WithCas){
+
+        if (p_Key.size() > mMaxKeyLength || !mCache->Lookup(KeyTraits<key_type>::Parse(p_Key), p_Connection.value) ||
+                p_Connection.value.size() < sizeof(flags_type))
+            return;
+
+        flags_type flags;
+        std::memcpy(&flags, p_Connection.value.data(), sizeof(flags_type));
+        const std::string_view payload = std::string_view(p_Connection.value).substr(sizeof(flags_type));
+
+        char number[24];
+        std::string& out = p_Connection.out;
+        out.append("VALUE ").append(p_Key).append(" ");
+        out.append(number, std::to_chars(number, number + sizeof(number), flags).ptr - number).append(" ");
+        out.append(number, std::to_chars(number, number + sizeof(number), payload.size()).ptr - number);
+        if (p_WithCas)
+            out.append(" 0");
+        out.append("\r\n").append(payload).append("\r\n");
+    }
+
+    /*
+     * @brief       store a set request, memcached exptime is seconds relative up to 30 days
+     *              and an absolute unix time above that, negative or past expires right away
+     *
+     * @return      reply line
+    */
+    std::string_view Store(Connection& p_Connection, std::string_view p_Key, flags_type p_Flags, long p_Expiry, std::string_view p_Payload){
+
+        const key_type key = KeyTraits<key_type>::Parse(p_Key);
+        constexpr long relative_limit = 60 * 60 * 24 * 30;
+        const bool absolute = (p_Expiry > relative_limit);
+        if (absolute)
+            p_Expiry -= static_cast<long>(std::time(nullptr));
+        // relative 0 never expires, an absolute time that is now has passed already
+        if (p_Expiry < 0 || (absolute && p_Expiry == 0)){
+
+            mCache->Remove(key);
+            return "STORED\r\n";
+        }
+
+        // flags go in front of the value, connection value buffer is reused so no allocation per request
+        value_type& value = p_Connection.value;
+        value.assign(reinterpret_cast<const char*>(&p_Flags), sizeof(flags_type)).append(p_Payload);
+        mCache->Put(key, value, std::chrono::seconds(p_Expiry));
+        return "STORED\r\n";
+    }
+
+private:
+    std::shared_ptr<CACHE> mCache;
+    uint16_t mPort;
+    std::vector<Reactor> mReactors;
+    bool mListening = false;
+    std::atomic_bool mStopped = false;
+};
+
+#endif // MEMCACHED_SERVER_H
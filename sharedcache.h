@@ -0,0 +1,779 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef SHARED_CACHE_H
+#define SHARED_CACHE_H
+
+#ifdef USING_BOOST_IPC
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <limits>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <signal.h>
+#include <unistd.h>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/offset_ptr.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include "fileutility.h"
+#include "utilstructs.h"
+#include "cachekey.h"
+#include "valuestorage.h"
+#include "readbuffer.h"
+#include "topology.h"
+
+/*
+ * One cache buffer in shared memory. LFUCacheBuffer is too wide for a lock free atomic so
+ * std::atomic of it goes through the libatomic lock table, which is per process.
+ * Here status and a version share one 64 bit word (always lock free and address free)
+ * and guard key/data seqlock style, frequency has its own word so hits do not bump the version.
+*/
+template<typename Key, typename Value>
+struct alignas(64) SharedCacheSlot{
+
+    std::atomic<uint64_t> header;                       //version << 8 | status
+    std::atomic<uint32_t> frequency;
+    Key key;
+    Value data;
+};
+
+/*
+ * Root object of the segment, found by name by every process attaching to the cache.
+ * Slots and index are reached through offset_ptr since each process maps the segment at its own address
+*/
+template<typename Key, typename Value>
+struct SharedCacheSegment{
+
+    using slot_type = SharedCacheSlot<Key, Value>;
+    using slot_index = int32_t;
+
+    std::size_t numberOfBuffers = 0;
+    boost::interprocess::offset_ptr<slot_type> slots;
+    boost::interprocess::offset_ptr<std::atomic<slot_index>> index;
+    std::atomic<uint32_t> nextScan{0};                  //where the next victim scan starts
+    std::atomic<int32_t> agingProcess{0};               //pid aging frequencies for everybody
+    std::atomic<std::size_t> dirtyBuffers{0};
+    std::atomic<std::size_t> written{0};
+    std::atomic<std::size_t> dirtyEvictions{0};
+    std::atomic<std::size_t> cleanEvictions{0};
+    std::atomic<std::size_t> cleanLoads{0};
+    std::atomic<std::size_t> unchangedWrites{0};
+};
+
+/*
+ * LFU cache whose free list, index and eviction metadata live in a managed_shared_memory segment
+ * so several processes attach to one cache, the first one creates the segment and the items file.
+ *  # - index is direct mapped over every value of the key so a lookup is one atomic load, no lock
+ *  # - Get hit is a seqlock read of the slot, Put hit a CAS to BUSY on it, nothing crosses a process boundary
+ *  # - slots are claimed/evicted with CAS like the in process cache, a dirty victim is written back while BUSY
+ *  # - only the mapping of the (FIXED_WIDTH) items file is per process
+ * Keys must be line addressable and values fixed width since heap pointers (slab pages, StringKey)
+ * mean nothing in another process. TTL and readahead are not supported, a process dying while it
+ * holds a slot BUSY leaves that slot unusable until the segment is removed.
+*/
+template<typename Key, typename Value>
+class SharedMemoryLFUImplementation : public ICacheInterface<Key, Value>
+{
+    using segment_type = SharedCacheSegment<Key, Value>;
+    using slot_type = typename segment_type::slot_type;
+    using slot_index = typename segment_type::slot_index;
+    using value_storage = ValueStorage<Value>;
+    using index_key_type = std::make_unsigned_t<Key>;
+
+    static_assert(KeyTraits<Key>::line_addressable && value_storage::fits_fixed_width && std::is_trivially_copyable_v<Value>,
+                  "shared memory cache needs line addressable keys and fixed width values");
+
+    enum class SLOT_STATUS: uint8_t{
+
+        // same life cycle as BUFFER_STATUS of the in process cache
+        FREE=0,
+        BUSY,
+        DIRTY,
+        VALID,
+    };
+
+    enum class READ_RESULT: int8_t{
+
+        HIT = 0,
+        MISS,
+        RETRY,
+    };
+
+public:
+    explicit SharedMemoryLFUImplementation(std::size_t p_Maxsize, const std::string& p_FileName, const std::string& p_SegmentName)
+        :mSegment(boost::interprocess::open_or_create, p_SegmentName.c_str(), SegmentBytes(p_Maxsize)){
+
+        // find or build the root objects under the segment mutex so racing processes agree on who created it
+        bool created = false;
+        auto find_or_construct = [&](){
+
+            mHeader = mSegment.find<segment_type>(mHeaderName).first;
+            if (mHeader)
+                return;
+
+            created = true;
+            slot_type* slots = mSegment.construct<slot_type>(mSlotsName)[p_Maxsize]();
+            for (std::size_t i = 0; i < p_Maxsize; ++i){
+
+                slots[i].header.store(MakeHeader(0, SLOT_STATUS::FREE), std::memory_order_relaxed);
+                slots[i].frequency.store(0, std::memory_order_relaxed);
+            }
+            std::atomic<slot_index>* index = mSegment.construct<std::atomic<slot_index>>(mIndexName)[IndexSize()](EMPTY_SLOT);
+            mHeader = mSegment.construct<segment_type>(mHeaderName)();
+            mHeader->numberOfBuffers = p_Maxsize;
+            mHeader->slots = slots;
+            mHeader->index = index;
+        };
+        mSegment.atomic_func(find_or_construct);
+
+        // attaching processes adopt the geometry of the creator and must not wipe the items file under it
+        mNumberOfBuffers = mHeader->numberOfBuffers;
+        mSlots = mHeader->slots.get();
+        mIndex = mHeader->index.get();
+        mFileUtility.reset(new FileUtility(p_FileName, RECORD_FORMAT::FIXED_WIDTH, created));
+    }
+
+    SharedMemoryLFUImplementation(const SharedMemoryLFUImplementation&) = delete;
+    SharedMemoryLFUImplementation& operator=(const SharedMemoryLFUImplementation&) = delete;
+
+    ~SharedMemoryLFUImplementation(){
+
+        // segment outlives the process, other processes (or the next run) keep using the cache
+        int32_t self = static_cast<int32_t>(::getpid());
+        mHeader->agingProcess.compare_exchange_strong(self, 0);
+    }
+
+    /*
+     * @brief       remove segment p_SegmentName, processes still attached keep their mapping
+     *
+     * @return      true if segment existed
+    */
+    static bool RemoveSegment(const std::string& p_SegmentName){
+
+        return boost::interprocess::shared_memory_object::remove(p_SegmentName.c_str());
+    }
+
+    bool GetCachedValue(int p_Index, Value& p_Value){
+
+        if (p_Index < 0 || (std::size_t)p_Index >= mNumberOfBuffers)
+            return false;
+
+        Key key;
+        return (ReadSlot(p_Index, nullptr, p_Value, key) == READ_RESULT::HIT);
+    }
+
+    bool SetCachedValue(int p_Index, const Value& p_Value){
+
+        if (p_Index < 0 || (std::size_t)p_Index >= mNumberOfBuffers)
+            return false;
+
+        return (WriteSlot(p_Index, nullptr, p_Value) == READ_RESULT::HIT);
+    }
+
+    std::size_t DrainReadBuffers(){
+
+        return mReadBuffer.Drain([this](int32_t p_Index){
+
+            std::atomic<uint32_t>& frequency = mSlots[p_Index].frequency;
+            uint32_t current = frequency.load(std::memory_order_relaxed);
+            while (current < (uint32_t)std::numeric_limits<short>::max() &&
+                   !frequency.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+        });
+    }
+
+    /*
+     * @brief       halve every frequency, one attached process ages for all of them
+     *              otherwise the cache would decay once per process and period
+     *
+     * @return      number of buffers aged
+    */
+    std::size_t AgeFrequencies(){
+
+        DrainReadBuffers();
+
+        const int32_t self = static_cast<int32_t>(::getpid());
+        int32_t owner = mHeader->agingProcess.load(std::memory_order_relaxed);
+        if (owner != self){
+
+            // take over from a process that exited without handing it back
+            if (owner != 0 && ::kill(owner, 0) == 0)
+                return 0;
+            if (!mHeader->agingProcess.compare_exchange_strong(owner, self))
+                return 0;
+        }
+
+        std::size_t aged = 0;
+        for (std::size_t i = 0; i < mNumberOfBuffers; ++i){
+
+            std::atomic<uint32_t>& frequency = mSlots[i].frequency;
+            uint32_t current = frequency.load(std::memory_order_relaxed);
+            while (current && !frequency.compare_exchange_weak(current, current >> 1, std::memory_order_relaxed));
+            if (current)
+                aged++;
+        }
+        return aged;
+    }
+
+    /*
+     * @brief       same contract as the in process cache, a miss loads the value from items file
+     *              as a clean buffer
+     *
+     * @return      true if cache miss happened
+    */
+    const bool Get(const Key& p_Position, Value& p_PositionValue){
+
+        for (;;){
+
+            const slot_index index = mIndex[KeyIndex(p_Position)].load(std::memory_order_acquire);
+            if (index != EMPTY_SLOT){
+
+                Key key;
+                const READ_RESULT result = ReadSlot(index, &p_Position, p_PositionValue, key);
+                if (result == READ_RESULT::HIT)
+                    return false;
+                if (result == READ_RESULT::RETRY){
+
+                    std::this_thread::yield();
+                    continue;
+                }
+            }
+
+            std::string record;
+            mFileUtility->ReadItem(p_Position, record);
+            value_storage::Parse(record, p_PositionValue);
+            if (Insert(p_Position, p_PositionValue, SLOT_STATUS::VALID)){
+
+                mHeader->cleanLoads.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            // another thread or process loaded it meanwhile, read their copy
+        }
+    }
+
+    void Put(const Key& p_Position, const Value& p_Value){
+
+        // a line number past the items file could never be written back
+        if (!mFileUtility->Stores(p_Position))
+            return;
+
+        for (;;){
+
+            const slot_index index = mIndex[KeyIndex(p_Position)].load(std::memory_order_acquire);
+            if (index != EMPTY_SLOT){
+
+                const READ_RESULT result = WriteSlot(index, &p_Position, p_Value);
+                if (result == READ_RESULT::HIT)
+                    return;
+                if (result == READ_RESULT::RETRY){
+
+                    std::this_thread::yield();
+                    continue;
+                }
+            }
+
+            if (Insert(p_Position, p_Value, SLOT_STATUS::DIRTY))
+                return;
+        }
+    }
+
+    // expiry needs a timer wheel per segment, entries of the shared cache never expire
+    void Put(const Key& p_Position, const Value& p_Value, std::chrono::milliseconds){
+
+        Put(p_Position, p_Value);
+    }
+
+    bool Lookup(const Key& p_Position, Value& p_Value){
+
+        std::string record;
+        if (mIndex[KeyIndex(p_Position)].load(std::memory_order_acquire) == EMPTY_SLOT && !mFileUtility->ReadItem(p_Position, record))
+            return false;
+
+        Get(p_Position, p_Value);
+        return true;
+    }
+
+    bool Remove(const Key& p_Position){
+
+        bool removed = false;
+        for (;;){
+
+            slot_index index = mIndex[KeyIndex(p_Position)].load(std::memory_order_acquire);
+            if (index == EMPTY_SLOT)
+                break;
+
+            slot_type& slot = mSlots[index];
+            uint64_t header = slot.header.load(std::memory_order_acquire);
+            const SLOT_STATUS status = StatusOf(header);
+            if (status == SLOT_STATUS::BUSY || status == SLOT_STATUS::FREE ||
+                    !slot.header.compare_exchange_strong(header, MakeHeader(VersionOf(header), SLOT_STATUS::BUSY))){
+
+                std::this_thread::yield();
+                continue;
+            }
+            if (slot.key != p_Position){
+
+                // slot was reused for another key before we claimed it
+                slot.header.store(header, std::memory_order_release);
+                continue;
+            }
+
+            if (status == SLOT_STATUS::DIRTY)
+                mHeader->dirtyBuffers.fetch_sub(1, std::memory_order_relaxed);
+            mIndex[KeyIndex(p_Position)].compare_exchange_strong(index, EMPTY_SLOT);
+            slot.frequency.store(0, std::memory_order_relaxed);
+            slot.header.store(MakeHeader(VersionOf(header) + 1, SLOT_STATUS::FREE), std::memory_order_release);
+            removed = true;
+            break;
+        }
+
+        return (mFileUtility->EraseItem(p_Position) || removed);
+    }
+
+    void Flush(){
+
+        for (std::size_t i = 0; i < mNumberOfBuffers; ++i)
+            WritebackSlot(i);
+    }
+
+    void SetWritebackPolicy(const WritebackPolicy& p_Policy){
+
+        mWritebackPolicy = p_Policy;
+    }
+
+    /*
+     * @brief       periodic flush of every attached process, a slot is written by whoever claims it first
+     *
+     * @return      number of buffers written
+    */
+    std::size_t Writeback(std::chrono::milliseconds p_MaxWait){
+
+        std::this_thread::sleep_for(p_MaxWait);
+        const auto now = std::chrono::steady_clock::now();
+        if (now - mLastWriteback < mWritebackPolicy.interval)
+            return 0;
+
+        mLastWriteback = now;
+        std::size_t written = 0;
+        for (std::size_t i = 0; i < mNumberOfBuffers; ++i)
+            if (WritebackSlot(i))
+                written++;
+        return written;
+    }
+
+    // writeback of the slots is shared by every attached process, only write back is supported
+    bool SetWriteMode(WRITE_MODE p_Mode){
+
+        return (p_Mode == WRITE_MODE::WRITE_BACK);
+    }
+
+    WritebackStats WritebackStatistics() const{
+
+        WritebackStats stats;
+        stats.dirtyBuffers = mHeader->dirtyBuffers.load(std::memory_order_relaxed);
+        stats.written = mHeader->written.load(std::memory_order_relaxed);
+        stats.dirtyEvictions = mHeader->dirtyEvictions.load(std::memory_order_relaxed);
+        stats.cleanEvictions = mHeader->cleanEvictions.load(std::memory_order_relaxed);
+        stats.cleanLoads = mHeader->cleanLoads.load(std::memory_order_relaxed);
+        stats.unchangedWrites = mHeader->unchangedWrites.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    std::size_t AdvanceTimers(){
+
+        return 0;
+    }
+
+    void SetDefaultTimeToLive(std::chrono::milliseconds){}
+
+    void SetExpiryRemoves(bool){}
+
+    std::chrono::milliseconds TimerResolution() const{
+
+        return std::chrono::milliseconds(100);
+    }
+
+    // segment size is fixed when it is created
+    void SetMemoryBudget(std::size_t){}
+
+    CacheMemoryUsage MemoryUsage() const{
+
+        CacheMemoryUsage usage;
+        usage.bufferBytes = mNumberOfBuffers * sizeof(slot_type);
+        usage.indexBytes = IndexSize() * sizeof(std::atomic<slot_index>);
+        usage.budgetBytes = mSegment.get_size();
+        for (std::size_t i = 0; i < mNumberOfBuffers; ++i){
+
+            const SLOT_STATUS status = StatusOf(mSlots[i].header.load(std::memory_order_relaxed));
+            if (status == SLOT_STATUS::VALID || status == SLOT_STATUS::DIRTY)
+                usage.numberOfEntries++;
+        }
+        return usage;
+    }
+
+    void SetReadahead(std::size_t){}
+
+    // evicted entries are only in the items file
+    void SetWarmTierBudget(std::size_t){}
+
+    WarmTierStats WarmTierStatistics() const{
+
+        return WarmTierStats{};
+    }
+
+    // Get/Put are measured by the manager, slot claims here are not split out as evictions
+    void SetPerfCounters(PerfCounters*){}
+
+    // misses of other processes can not be waited for, racing loads are settled by the index CAS
+    MissStats MissStatistics() const{
+
+        return MissStats{};
+    }
+
+    std::size_t Readahead(std::chrono::milliseconds p_MaxWait){
+
+        std::this_thread::sleep_for(p_MaxWait);
+        return 0;
+    }
+
+    ReadaheadStats ReadaheadStatistics() const{
+
+        return ReadaheadStats{};
+    }
+
+    bool PlaceMemory(const std::vector<int>& p_Nodes){
+
+        return BindMemoryToNodes(mSegment.get_address(), mSegment.get_size(), p_Nodes);
+    }
+
+    /*
+     * @brief       visit every entry of the segment, each one is a seqlock copy of its slot
+     *              that does not count as a hit, entries of every attached process are visited
+     *
+     * @return      number of entries visited, p_Visitor returning false stops the walk
+    */
+    std::size_t ForEachEntry(const std::function<bool(const CacheEntry<Key, Value>&)>& p_Visitor){
+
+        std::size_t visited = 0;
+        for (std::size_t i = 0; i < mNumberOfBuffers; ++i){
+
+            slot_type& slot = mSlots[i];
+            CacheEntry<Key, Value> entry;
+            bool resident = false;
+            for (;;){
+
+                const uint64_t before = slot.header.load(std::memory_order_acquire);
+                const SLOT_STATUS status = StatusOf(before);
+                if (status == SLOT_STATUS::BUSY || status == SLOT_STATUS::FREE)
+                    break;
+
+                entry.key = slot.key;
+                entry.value = slot.data;
+                entry.frequency = static_cast<short>(std::min<uint32_t>(slot.frequency.load(std::memory_order_relaxed), std::numeric_limits<short>::max()));
+                entry.dirty = (status == SLOT_STATUS::DIRTY);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.header.load(std::memory_order_relaxed) == before){
+
+                    resident = true;
+                    break;
+                }
+            }
+
+            if (resident){
+
+                visited++;
+                if (!p_Visitor(entry))
+                    break;
+            }
+        }
+        return visited;
+    }
+
+    // geometry is fixed when the segment is created
+    bool Resize(std::size_t){
+
+        return false;
+    }
+
+    std::size_t RelocateBuffers(std::size_t){
+
+        return 0;
+    }
+
+    std::size_t NumberOfBuffers() const{
+
+        return mNumberOfBuffers;
+    }
+
+private:
+    static constexpr slot_index EMPTY_SLOT = -1;
+    static constexpr const char* mHeaderName = "lfu_segment";
+    static constexpr const char* mSlotsName = "lfu_slots";
+    static constexpr const char* mIndexName = "lfu_index";
+
+    static constexpr std::size_t IndexSize(){
+
+        return static_cast<std::size_t>(std::numeric_limits<index_key_type>::max()) + 1;
+    }
+
+    static std::size_t KeyIndex(const Key& p_Key){
+
+        return static_cast<index_key_type>(p_Key);
+    }
+
+    static std::size_t SegmentBytes(std::size_t p_Maxsize){
+
+        // named object headers, alignment and the allocator bookkeeping
+        constexpr std::size_t overhead = 64 * 1024;
+        return sizeof(segment_type) + (p_Maxsize * sizeof(slot_type)) + (IndexSize() * sizeof(std::atomic<slot_index>)) + overhead;
+    }
+
+    static uint64_t MakeHeader(uint64_t p_Version, SLOT_STATUS p_Status){
+
+        return (p_Version << 8) | (uint64_t)p_Status;
+    }
+
+    static uint64_t VersionOf(uint64_t p_Header){
+
+        return (p_Header >> 8);
+    }
+
+    static SLOT_STATUS StatusOf(uint64_t p_Header){
+
+        return (SLOT_STATUS)(p_Header & 0xFF);
+    }
+
+    /*
+     * @brief       seqlock read of slot p_Index, p_Expected (if given) must be the key stored in it
+     *
+     * @return      HIT if p_Value/p_Key are a consistent copy, MISS if the slot holds another key
+     *              RETRY if it is being written or reused
+    */
+    READ_RESULT ReadSlot(slot_index p_Index, const Key* p_Expected, Value& p_Value, Key& p_Key){
+
+        slot_type& slot = mSlots[p_Index];
+        const uint64_t before = slot.header.load(std::memory_order_acquire);
+        const SLOT_STATUS status = StatusOf(before);
+        if (status == SLOT_STATUS::BUSY || status == SLOT_STATUS::FREE)
+            return (p_Expected ? READ_RESULT::RETRY : READ_RESULT::MISS);
+
+        p_Key = slot.key;
+        p_Value = slot.data;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.header.load(std::memory_order_relaxed) != before)
+            return READ_RESULT::RETRY;
+
+        // index still pointed at a slot evicted and reused meanwhile, eviction unmaps it shortly
+        if (p_Expected && p_Key != *p_Expected)
+            return READ_RESULT::RETRY;
+
+        if (mReadBuffer.Record(p_Index))
+            DrainReadBuffers();
+        return READ_RESULT::HIT;
+    }
+
+    /*
+     * @brief       overwrite the value in slot p_Index, p_Expected (if given) must be the key stored in it
+     *
+     * @return      HIT if written, RETRY if slot is being written or reused
+    */
+    READ_RESULT WriteSlot(slot_index p_Index, const Key* p_Expected, const Value& p_Value){
+
+        slot_type& slot = mSlots[p_Index];
+        uint64_t header = slot.header.load(std::memory_order_acquire);
+        const SLOT_STATUS status = StatusOf(header);
+        if (status == SLOT_STATUS::BUSY || status == SLOT_STATUS::FREE)
+            return READ_RESULT::RETRY;
+        if (!slot.header.compare_exchange_strong(header, MakeHeader(VersionOf(header), SLOT_STATUS::BUSY)))
+            return READ_RESULT::RETRY;
+        if (p_Expected && slot.key != *p_Expected){
+
+            slot.header.store(header, std::memory_order_release);
+            return READ_RESULT::RETRY;
+        }
+
+        uint32_t frequency = slot.frequency.load(std::memory_order_relaxed);
+        if (frequency < (uint32_t)std::numeric_limits<short>::max())
+            slot.frequency.store(frequency + 1, std::memory_order_relaxed);
+        // same value: slot (and its version, readers saw the very same data) is put back as it was
+        if (slot.data == p_Value){
+
+            slot.header.store(header, std::memory_order_release);
+            mHeader->unchangedWrites.fetch_add(1, std::memory_order_relaxed);
+            return READ_RESULT::HIT;
+        }
+        slot.data = p_Value;
+        slot.header.store(MakeHeader(VersionOf(header) + 1, SLOT_STATUS::DIRTY), std::memory_order_release);
+        if (status != SLOT_STATUS::DIRTY)
+            mHeader->dirtyBuffers.fetch_add(1, std::memory_order_relaxed);
+        return READ_RESULT::HIT;
+    }
+
+    /*
+     * @brief       fill a claimed slot with p_Key and publish it in the index while still BUSY
+     *              so no reader sees the slot before the index agrees with it
+     *
+     * @return      false if p_Key got mapped by somebody else meanwhile, slot is given back
+    */
+    bool Insert(const Key& p_Key, const Value& p_Value, SLOT_STATUS p_Status){
+
+        const slot_index index = ClaimSlot();
+        slot_type& slot = mSlots[index];
+        const uint64_t version = VersionOf(slot.header.load(std::memory_order_relaxed)) + 1;
+        slot.key = p_Key;
+        slot.data = p_Value;
+        slot.frequency.store(1, std::memory_order_relaxed);
+
+        slot_index expected = EMPTY_SLOT;
+        if (!mIndex[KeyIndex(p_Key)].compare_exchange_strong(expected, index)){
+
+            slot.frequency.store(0, std::memory_order_relaxed);
+            slot.header.store(MakeHeader(version, SLOT_STATUS::FREE), std::memory_order_release);
+            return false;
+        }
+
+        if (p_Status == SLOT_STATUS::DIRTY)
+            mHeader->dirtyBuffers.fetch_add(1, std::memory_order_relaxed);
+        slot.header.store(MakeHeader(version, p_Status), std::memory_order_release);
+        return true;
+    }
+
+    /*
+     * @brief       claim a FREE slot or evict the least frequently used one, scan starts where
+     *              the previous one of any process stopped so claimers do not all fight over slot 0
+     *
+     * @return      slot index owned by this thread (status BUSY)
+    */
+    slot_index ClaimSlot(){
+
+        for(;;){
+
+            DrainReadBuffers();
+
+            const std::size_t start = mHeader->nextScan.fetch_add(1, std::memory_order_relaxed) % mNumberOfBuffers;
+            slot_index victim = EMPTY_SLOT;
+            uint64_t victim_header = 0;
+            uint32_t least_count = std::numeric_limits<uint32_t>::max();
+            for (std::size_t n = 0; n < mNumberOfBuffers; ++n){
+
+                const slot_index index = static_cast<slot_index>((start + n) % mNumberOfBuffers);
+                slot_type& slot = mSlots[index];
+                uint64_t header = slot.header.load(std::memory_order_acquire);
+                const SLOT_STATUS status = StatusOf(header);
+                if (status == SLOT_STATUS::FREE){
+
+                    if (slot.header.compare_exchange_strong(header, MakeHeader(VersionOf(header), SLOT_STATUS::BUSY)))
+                        return index;
+                    continue;
+                }
+                if (status == SLOT_STATUS::BUSY)
+                    continue;
+
+                const uint32_t frequency = slot.frequency.load(std::memory_order_relaxed);
+                if (frequency < least_count){
+
+                    least_count = frequency;
+                    victim = index;
+                    victim_header = header;
+                }
+            }
+
+            if (victim == EMPTY_SLOT || !mSlots[victim].header.compare_exchange_strong(victim_header,
+                                                                                       MakeHeader(VersionOf(victim_header), SLOT_STATUS::BUSY))){
+
+                // every slot BUSY or victim changed under us
+                std::this_thread::yield();
+                continue;
+            }
+
+            EvictSlot(victim, victim_header);
+            return victim;
+        }
+    }
+
+    // slot is BUSY and owned by this thread, readers of its key spin until it is unmapped
+    void EvictSlot(slot_index p_Index, uint64_t p_Header){
+
+        slot_type& slot = mSlots[p_Index];
+        if (StatusOf(p_Header) == SLOT_STATUS::DIRTY){
+
+            std::string record;
+            value_storage::Serialize(mSlabAllocator, slot.data, record);
+            mFileUtility->WriteItem(slot.key, record);
+            mHeader->dirtyBuffers.fetch_sub(1, std::memory_order_relaxed);
+            mHeader->dirtyEvictions.fetch_add(1, std::memory_order_relaxed);
+        }else{
+
+            mHeader->cleanEvictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        slot_index expected = p_Index;
+        mIndex[KeyIndex(slot.key)].compare_exchange_strong(expected, EMPTY_SLOT);
+        slot.frequency.store(0, std::memory_order_relaxed);
+    }
+
+    /*
+     * @brief       write slot p_Index to items file if it is DIRTY, readers spin on BUSY meanwhile
+     *
+     * @return      true if written
+    */
+    bool WritebackSlot(std::size_t p_Index){
+
+        slot_type& slot = mSlots[p_Index];
+        uint64_t header = slot.header.load(std::memory_order_acquire);
+        if (StatusOf(header) != SLOT_STATUS::DIRTY ||
+                !slot.header.compare_exchange_strong(header, MakeHeader(VersionOf(header), SLOT_STATUS::BUSY)))
+            return false;
+
+        std::string record;
+        value_storage::Serialize(mSlabAllocator, slot.data, record);
+        mFileUtility->WriteItem(slot.key, record);
+        slot.header.store(MakeHeader(VersionOf(header), SLOT_STATUS::VALID), std::memory_order_release);
+        mHeader->dirtyBuffers.fetch_sub(1, std::memory_order_relaxed);
+        mHeader->written.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    boost::interprocess::managed_shared_memory mSegment;
+    segment_type* mHeader = nullptr;
+    slot_type* mSlots = nullptr;                        //this process' view of the segment
+    std::atomic<slot_index>* mIndex = nullptr;
+    std::size_t mNumberOfBuffers = 0;
+    std::unique_ptr<FileUtility> mFileUtility;
+    SlabAllocator mSlabAllocator;                       //unused by fixed width values, needed by ValueStorage
+    ReadBuffer mReadBuffer;                             //hits of this process not yet applied to frequency
+    WritebackPolicy mWritebackPolicy;
+    std::chrono::steady_clock::time_point mLastWriteback = std::chrono::steady_clock::now();
+};
+
+#endif // USING_BOOST_IPC
+
+#endif // SHARED_CACHE_H
@@ -0,0 +1,127 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+/*
+ * Misses of one key in flight at the same time, the first one to Join leads and loads, every later
+ * one waits until the leader's ticket goes out of scope and then finds the buffer it filled.
+ * Only misses go through here, hits never take mGuard.
+*/
+template<typename Key, typename Hash = std::hash<Key>>
+class SingleFlight
+{
+    struct Flight{
+
+        bool landed = false;
+        std::condition_variable done;
+    };
+
+public:
+    class Ticket
+    {
+    public:
+        Ticket(SingleFlight& p_Owner, const Key& p_Key, std::shared_ptr<Flight> p_Flight, bool p_Leader)
+            :mOwner(p_Owner), mKey(p_Key), mFlight(std::move(p_Flight)), mLeader(p_Leader){}
+
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+
+        // leader lands the flight however it leaves the miss path
+        ~Ticket(){
+
+            if (mLeader)
+                mOwner.Land(mKey, *mFlight);
+        }
+
+        bool Leader() const{
+
+            return mLeader;
+        }
+
+        // follower blocks until the leader landed
+        void Wait(){
+
+            std::unique_lock lk(mOwner.mGuard);
+            mFlight->done.wait(lk, [this](){ return mFlight->landed; });
+        }
+
+    private:
+        SingleFlight& mOwner;
+        const Key mKey;
+        std::shared_ptr<Flight> mFlight;
+        const bool mLeader;
+    };
+
+    SingleFlight() = default;
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    /*
+     * @brief       join the flight of p_Key, starting it if there is none
+     *
+     * @return      ticket, Leader() tells whether the caller has to do the load
+    */
+    Ticket Join(const Key& p_Key){
+
+        std::lock_guard lk(mGuard);
+        auto [itr, started] = mFlights.try_emplace(p_Key);
+        if (started)
+            itr->second = std::make_shared<Flight>();
+        else
+            mCoalesced.fetch_add(1, std::memory_order_relaxed);
+        return Ticket(*this, p_Key, itr->second, started);
+    }
+
+    // followers that waited instead of loading themselves
+    std::size_t Coalesced() const{
+
+        return mCoalesced.load(std::memory_order_relaxed);
+    }
+
+private:
+    void Land(const Key& p_Key, Flight& p_Flight){
+
+        std::lock_guard lk(mGuard);
+        p_Flight.landed = true;
+        mFlights.erase(p_Key);
+        p_Flight.done.notify_all();
+    }
+
+private:
+    std::mutex mGuard;
+    std::unordered_map<Key, std::shared_ptr<Flight>, Hash> mFlights;
+    std::atomic<std::size_t> mCoalesced{0};
+};
+
+#endif // SINGLE_FLIGHT_H
@@ -0,0 +1,321 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+
+#include "utilstructs.h"
+
+/*
+ * Size class slab allocator for variable length cache payloads.
+ * Every size class owns pages carved into equal chunks, pages are never unmapped
+ * so a reader holding a stale handle can always dereference it safely and detect the reuse
+ * through the per chunk generation (seqlock style) instead of crashing.
+ * Under a memory budget the data of an empty page is given back with madvise, it stays mapped
+ * and faults in zeroed on next use so stale readers still only see a changed generation.
+*/
+class SlabAllocator
+{
+public:
+    static constexpr std::size_t mMinChunkSize = 64;
+    static constexpr std::size_t mMaxChunkSize = 4096;
+    static constexpr std::size_t mNumberOfClasses = 7;                  //64, 128, ... 4096
+    static constexpr std::size_t mPageSize = 256 * 1024;                //default and largest page
+    static constexpr std::size_t mMaxPagesPerClass = 1024;
+
+    SlabAllocator() = default;
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    ~SlabAllocator(){
+
+        for (auto& size_class : mClasses){
+
+            for (auto& page : size_class.pages){
+
+                delete page.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*
+     * @brief       copy the payload into a chunk of the smallest fitting size class
+     *
+     * @return      handle to the payload, empty payloads do not consume a chunk
+    */
+    SlabHandle Allocate(std::string_view p_Payload){
+
+        SlabHandle handle;
+        handle.length = static_cast<uint32_t>(p_Payload.size());
+        if (p_Payload.empty())
+            return handle;
+
+        if (p_Payload.size() > mMaxChunkSize){
+
+            throw std::length_error("value larger than " + std::to_string(mMaxChunkSize) + " bytes");
+        }
+
+        const uint32_t class_index = SizeClassOf(p_Payload.size());
+        SizeClass& size_class = mClasses[class_index];
+        uint32_t chunk_index;
+        Page* page;
+        {
+            std::lock_guard lk(size_class.guard);
+            if (size_class.freeChunks.empty())
+                AddPage(class_index);
+            chunk_index = size_class.freeChunks.back();
+            size_class.freeChunks.pop_back();
+            page = size_class.pages[chunk_index / ChunksPerPage(class_index)].load(std::memory_order_relaxed);
+            if (page->usedChunks++ == 0 && page->released){
+
+                page->released = false;
+                mReservedBytes.fetch_add(page->length, std::memory_order_relaxed);
+            }
+        }
+
+        const uint32_t slot = chunk_index % ChunksPerPage(class_index);
+        std::memcpy(page->data + (slot * ChunkSize(class_index)), p_Payload.data(), p_Payload.size());
+
+        handle.chunk = (class_index << mClassShift) | chunk_index;
+        handle.generation = page->generations[slot].load(std::memory_order_relaxed);
+        mUsedBytes.fetch_add(ChunkSize(class_index), std::memory_order_relaxed);
+        // publish payload before the handle gets visible through the free list CAS
+        std::atomic_thread_fence(std::memory_order_release);
+
+        return handle;
+    }
+
+    /*
+     * @brief       compare the payload with p_Value in place, same generation checks as Read
+     *
+     * @return      true only if the handle is still current and holds exactly p_Value
+    */
+    bool Equals(const SlabHandle& p_Handle, std::string_view p_Value) const{
+
+        if (p_Handle.length != p_Value.size())
+            return false;
+        if (p_Handle.chunk == SlabHandle::INVALID_CHUNK)
+            return p_Value.empty();
+
+        const uint32_t class_index = p_Handle.chunk >> mClassShift;
+        const uint32_t chunk_index = p_Handle.chunk & mChunkMask;
+        const Page* page = mClasses[class_index].pages[chunk_index / ChunksPerPage(class_index)].load(std::memory_order_acquire);
+        const uint32_t slot = chunk_index % ChunksPerPage(class_index);
+
+        if (page->generations[slot].load(std::memory_order_acquire) != p_Handle.generation)
+            return false;
+
+        const bool equal = (std::memcmp(page->data + (slot * ChunkSize(class_index)), p_Value.data(), p_Value.size()) == 0);
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        return (equal && page->generations[slot].load(std::memory_order_relaxed) == p_Handle.generation);
+    }
+
+    /*
+     * @brief       copy out the payload, chunk might be released and reused while copying
+     *              so generation is checked before and after the copy
+     *
+     * @return      true if p_Out holds the payload false if the handle went stale
+    */
+    bool Read(const SlabHandle& p_Handle, std::string& p_Out) const{
+
+        if (p_Handle.chunk == SlabHandle::INVALID_CHUNK){
+
+            p_Out.clear();
+            return (p_Handle.length == 0);
+        }
+
+        const uint32_t class_index = p_Handle.chunk >> mClassShift;
+        const uint32_t chunk_index = p_Handle.chunk & mChunkMask;
+        const Page* page = mClasses[class_index].pages[chunk_index / ChunksPerPage(class_index)].load(std::memory_order_acquire);
+        const uint32_t slot = chunk_index % ChunksPerPage(class_index);
+
+        if (page->generations[slot].load(std::memory_order_acquire) != p_Handle.generation)
+            return false;
+
+        p_Out.assign(page->data + (slot * ChunkSize(class_index)), p_Handle.length);
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        return (page->generations[slot].load(std::memory_order_relaxed) == p_Handle.generation);
+    }
+
+    /*
+     * @brief       give the chunk back to its size class, bumping the generation first
+     *              invalidates every copy of the handle still held by readers
+     *
+     * @return      void
+    */
+    void Release(const SlabHandle& p_Handle){
+
+        if (p_Handle.chunk == SlabHandle::INVALID_CHUNK)
+            return;
+
+        const uint32_t class_index = p_Handle.chunk >> mClassShift;
+        const uint32_t chunk_index = p_Handle.chunk & mChunkMask;
+        SizeClass& size_class = mClasses[class_index];
+        Page* page = size_class.pages[chunk_index / ChunksPerPage(class_index)].load(std::memory_order_acquire);
+        page->generations[chunk_index % ChunksPerPage(class_index)].fetch_add(1, std::memory_order_acq_rel);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        mUsedBytes.fetch_sub(ChunkSize(class_index), std::memory_order_relaxed);
+        std::lock_guard lk(size_class.guard);
+        size_class.freeChunks.push_back(chunk_index);
+        if (--page->usedChunks == 0 && mReleaseEmptyPages.load(std::memory_order_relaxed) &&
+            ::madvise(page->data, page->length, MADV_DONTNEED) == 0){
+
+            page->released = true;
+            mReservedBytes.fetch_sub(page->length, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * @brief       size of the pages reserved from now on, rounded down to a power of two between
+     *              mMaxChunkSize and mPageSize, only possible before the first page is reserved
+     *
+     * @return      true if the page size was taken
+    */
+    bool SetPageSize(std::size_t p_Bytes){
+
+        if (mReservedBytes.load(std::memory_order_relaxed) != 0)
+            return false;
+
+        std::size_t page_bytes = mMaxChunkSize;
+        while (page_bytes * 2 <= std::min(p_Bytes, mPageSize))
+            page_bytes *= 2;
+        mPageBytes = page_bytes;
+        return true;
+    }
+
+    // give the data of pages whose chunks are all free back to the OS, ReservedBytes drops with them
+    void ReleaseEmptyPages(bool p_Release){
+
+        mReleaseEmptyPages.store(p_Release, std::memory_order_relaxed);
+    }
+
+    std::size_t ReservedBytes() const{
+
+        return mReservedBytes.load(std::memory_order_relaxed);
+    }
+
+    std::size_t UsedBytes() const{
+
+        return mUsedBytes.load(std::memory_order_relaxed);
+    }
+
+    static constexpr std::size_t ChunkSize(uint32_t p_ClassIndex){
+
+        return (mMinChunkSize << p_ClassIndex);
+    }
+
+private:
+    struct Page{
+
+        std::unique_ptr<std::atomic<uint32_t>[]> generations;
+        char* data = nullptr;                   //anonymous mapping of length bytes
+        std::size_t length = 0;
+        uint32_t usedChunks = 0;                //under size class guard
+        bool released = false;                  //data given back to the OS, zeroed on next use
+
+        ~Page(){
+
+            if (data)
+                ::munmap(data, length);
+        }
+    };
+
+    struct SizeClass{
+
+        std::array<std::atomic<Page*>, mMaxPagesPerClass> pages{};
+        std::size_t numberOfPages = 0;
+        std::vector<uint32_t> freeChunks;
+        std::mutex guard;
+    };
+
+    static constexpr uint32_t SizeClassOf(std::size_t p_Length){
+
+        uint32_t class_index = 0;
+        while (ChunkSize(class_index) < p_Length)
+            class_index++;
+        return class_index;
+    }
+
+    uint32_t ChunksPerPage(uint32_t p_ClassIndex) const{
+
+        return static_cast<uint32_t>(mPageBytes / ChunkSize(p_ClassIndex));
+    }
+
+    // caller must hold size class guard
+    void AddPage(uint32_t p_ClassIndex){
+
+        SizeClass& size_class = mClasses[p_ClassIndex];
+        if (size_class.numberOfPages == mMaxPagesPerClass){
+
+            throw std::bad_alloc();
+        }
+
+        const uint32_t chunks_per_page = ChunksPerPage(p_ClassIndex);
+        auto page = new Page;
+        page->generations.reset(new std::atomic<uint32_t>[chunks_per_page]);
+        for (uint32_t i = 0; i < chunks_per_page; ++i)
+            page->generations[i].store(0, std::memory_order_relaxed);
+        void* data = ::mmap(nullptr, mPageBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED){
+
+            delete page;
+            throw std::bad_alloc();
+        }
+        page->data = static_cast<char*>(data);
+        page->length = mPageBytes;
+
+        const uint32_t first_chunk = static_cast<uint32_t>(size_class.numberOfPages * chunks_per_page);
+        size_class.pages[size_class.numberOfPages++].store(page, std::memory_order_release);
+        for (uint32_t i = chunks_per_page; i > 0; --i)
+            size_class.freeChunks.push_back(first_chunk + i - 1);
+
+        mReservedBytes.fetch_add(mPageBytes + (chunks_per_page * sizeof(std::atomic<uint32_t>)), std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t mClassShift = 28;
+    static constexpr uint32_t mChunkMask = (1u << mClassShift) - 1;
+    std::array<SizeClass, mNumberOfClasses> mClasses;
+    std::atomic<std::size_t> mReservedBytes{0};                         //pages backed by memory, generations included
+    std::atomic<std::size_t> mUsedBytes{0};
+    std::size_t mPageBytes = mPageSize;
+    std::atomic<bool> mReleaseEmptyPages{false};
+};
+
+#endif // SLAB_ALLOCATOR_H
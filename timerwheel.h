@@ -0,0 +1,240 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+/*
+ * Hierarchical timer wheel (Varghese & Lauck, same idea as linux kernel timers) for per buffer expiry.
+ * One timer per buffer index, entries are intrusive doubly linked lists kept in plain arrays so
+ * Schedule/Cancel are O(1) and firing only cascades a bucket when a lower level wraps.
+ *  # - level 0 buckets are one tick wide, level N buckets are 64^N ticks wide
+ *  # - 4 levels of 64 buckets with 100ms tick cover ~19 days, longer TTLs are clamped
+*/
+class TimerWheel
+{
+public:
+    using timer_id = int;
+    using tick_type = uint64_t;
+    using resolution_type = std::chrono::milliseconds;
+
+    static constexpr tick_type NO_DEADLINE = 0;
+
+    explicit TimerWheel(std::size_t p_NumberOfTimers, resolution_type p_Resolution = resolution_type(100))
+        :mResolution(p_Resolution), mStart(std::chrono::steady_clock::now()),
+          mNext(p_NumberOfTimers, INVALID_TIMER), mPrev(p_NumberOfTimers, INVALID_TIMER),
+          mBucketOf(p_NumberOfTimers, INVALID_TIMER), mDeadlines(new std::atomic<tick_type>[p_NumberOfTimers]){
+
+        for (std::size_t i = 0; i < p_NumberOfTimers; ++i)
+            mDeadlines[i].store(NO_DEADLINE, std::memory_order_relaxed);
+        mBuckets.fill(INVALID_TIMER);
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /*
+     * @brief       (re)arm timer p_Id to fire p_TimeToLive from now, zero disarms it
+     *
+     * @return      void
+    */
+    void Schedule(timer_id p_Id, resolution_type p_TimeToLive){
+
+        // Put without TTL of a buffer that has none is the common case, nothing to unlink
+        if (p_TimeToLive.count() <= 0 && Deadline(p_Id) == NO_DEADLINE)
+            return;
+
+        std::lock_guard lk(mWheelGuard);
+        Unlink(p_Id);
+        if (p_TimeToLive.count() <= 0){
+
+            mDeadlines[p_Id].store(NO_DEADLINE, std::memory_order_release);
+            return;
+        }
+
+        const tick_type ticks = std::max<tick_type>(1, (p_TimeToLive + mResolution - resolution_type(1)) / mResolution);
+        const tick_type deadline = mCurrentTick.load(std::memory_order_relaxed) + std::min(ticks, mMaxTicks);
+        mDeadlines[p_Id].store(deadline, std::memory_order_release);
+        Link(p_Id, deadline);
+    }
+
+    void Cancel(timer_id p_Id){
+
+        std::lock_guard lk(mWheelGuard);
+        Unlink(p_Id);
+        mDeadlines[p_Id].store(NO_DEADLINE, std::memory_order_release);
+    }
+
+    tick_type Deadline(timer_id p_Id) const{
+
+        return mDeadlines[p_Id].load(std::memory_order_acquire);
+    }
+
+    // lock free check for the Get hit path, accurate to one tick
+    bool IsExpired(timer_id p_Id) const{
+
+        const tick_type deadline = Deadline(p_Id);
+        return (deadline != NO_DEADLINE && deadline <= mCurrentTick.load(std::memory_order_relaxed));
+    }
+
+    /*
+     * @brief       move the wheel up to wall clock now, p_OnExpiry(id, deadline) is called
+     *              for every timer that fired after the wheel lock is released
+     *
+     * @return      number of timers fired
+    */
+    template<typename Callback>
+    std::size_t Advance(Callback&& p_OnExpiry){
+
+        const tick_type now_tick = static_cast<tick_type>((std::chrono::steady_clock::now() - mStart) / mResolution);
+        std::vector<std::pair<timer_id, tick_type>> expired;
+        {
+            std::lock_guard lk(mWheelGuard);
+            tick_type current = mCurrentTick.load(std::memory_order_relaxed);
+            while (current < now_tick){
+
+                ++current;
+                mCurrentTick.store(current, std::memory_order_relaxed);
+
+                // when a level wraps pull the next bucket of the upper level down, highest level first
+                // so entries landing in a lower bucket that wraps on this very tick are cascaded again
+                uint32_t wrapped_levels = 0;
+                while (wrapped_levels + 1 < mLevels && (current & ((tick_type(1) << (mSlotBits * (wrapped_levels + 1))) - 1)) == 0)
+                    ++wrapped_levels;
+                for (uint32_t level = wrapped_levels; level >= 1; --level)
+                    Cascade(level, SlotOf(current, level));
+
+                timer_id id = mBuckets[SlotOf(current, 0)];
+                while (id != INVALID_TIMER){
+
+                    timer_id next = mNext[id];
+                    const tick_type deadline = mDeadlines[id].load(std::memory_order_relaxed);
+                    if (deadline <= current){
+
+                        Unlink(id);
+                        expired.emplace_back(id, deadline);
+                    }
+                    id = next;
+                }
+            }
+        }
+
+        for (const auto& [id, deadline] : expired)
+            p_OnExpiry(id, deadline);
+
+        return expired.size();
+    }
+
+    tick_type CurrentTick() const{
+
+        return mCurrentTick.load(std::memory_order_relaxed);
+    }
+
+    resolution_type Resolution() const{
+
+        return mResolution;
+    }
+
+private:
+    static constexpr timer_id INVALID_TIMER = -1;
+    static constexpr uint32_t mLevels = 4;
+    static constexpr uint32_t mSlotBits = 6;
+    static constexpr uint32_t mSlotsPerLevel = 1u << mSlotBits;
+    static constexpr tick_type mMaxTicks = (tick_type(1) << (mSlotBits * mLevels)) - 1;
+
+    static uint32_t SlotOf(tick_type p_Tick, uint32_t p_Level){
+
+        return static_cast<uint32_t>((p_Tick >> (mSlotBits * p_Level)) & (mSlotsPerLevel - 1));
+    }
+
+    // caller must hold mWheelGuard
+    void Link(timer_id p_Id, tick_type p_Deadline){
+
+        const tick_type delta = p_Deadline - mCurrentTick.load(std::memory_order_relaxed);
+        uint32_t level = 0;
+        while (level + 1 < mLevels && delta >= (tick_type(1) << (mSlotBits * (level + 1))))
+            ++level;
+
+        const int bucket = static_cast<int>(level * mSlotsPerLevel + SlotOf(p_Deadline, level));
+        mBucketOf[p_Id] = bucket;
+        mPrev[p_Id] = INVALID_TIMER;
+        mNext[p_Id] = mBuckets[bucket];
+        if (mBuckets[bucket] != INVALID_TIMER)
+            mPrev[mBuckets[bucket]] = p_Id;
+        mBuckets[bucket] = p_Id;
+    }
+
+    // caller must hold mWheelGuard
+    void Unlink(timer_id p_Id){
+
+        const int bucket = mBucketOf[p_Id];
+        if (bucket == INVALID_TIMER)
+            return;
+
+        if (mPrev[p_Id] != INVALID_TIMER)
+            mNext[mPrev[p_Id]] = mNext[p_Id];
+        else
+            mBuckets[bucket] = mNext[p_Id];
+        if (mNext[p_Id] != INVALID_TIMER)
+            mPrev[mNext[p_Id]] = mPrev[p_Id];
+
+        mNext[p_Id] = mPrev[p_Id] = mBucketOf[p_Id] = INVALID_TIMER;
+    }
+
+    // caller must hold mWheelGuard
+    void Cascade(uint32_t p_Level, uint32_t p_Slot){
+
+        timer_id id = mBuckets[p_Level * mSlotsPerLevel + p_Slot];
+        mBuckets[p_Level * mSlotsPerLevel + p_Slot] = INVALID_TIMER;
+        while (id != INVALID_TIMER){
+
+            timer_id next = mNext[id];
+            mBucketOf[id] = INVALID_TIMER;
+            Link(id, mDeadlines[id].load(std::memory_order_relaxed));
+            id = next;
+        }
+    }
+
+private:
+    const resolution_type mResolution;
+    const std::chrono::steady_clock::time_point mStart;
+    std::atomic<tick_type> mCurrentTick{0};
+    std::array<timer_id, mLevels * mSlotsPerLevel> mBuckets;
+    std::vector<timer_id> mNext;
+    std::vector<timer_id> mPrev;
+    std::vector<int> mBucketOf;
+    std::unique_ptr<std::atomic<tick_type>[]> mDeadlines;
+    std::mutex mWheelGuard;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,373 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <boost/lexical_cast.hpp>
+
+enum class THREAD_PLACEMENT: int8_t{
+
+    COMPACT = 0,            //fill SMT siblings and cores of one node before the next node
+    SPREAD,                 //one thread per core round robin over nodes, siblings last
+    PER_NODE,               //thread i may run on any cpu of node (i % nodes), a shard per node
+    EXPLICIT,               //cpu lists from config, separate for readers and writers
+};
+
+enum class THREAD_ROLE: int8_t{
+
+    READER = 0,
+    WRITER,
+};
+
+struct LogicalCpu{
+
+    int cpu;
+    int core;
+    int package;
+    int node;
+};
+
+/*
+ * Online cpus with their core/package/NUMA node as the kernel reports them under sysfs.
+ * Without sysfs (or readable topology) every cpu up to hardware_concurrency is its own core on node 0
+*/
+class CpuTopology
+{
+public:
+    explicit CpuTopology(const std::string& p_SysfsRoot = "/sys/devices/system"){
+
+        std::string online;
+        std::vector<int> cpus;
+        if (ReadFirstLine(p_SysfsRoot + "/cpu/online", online))
+            cpus = ParseCpuList(online);
+        if (cpus.empty()){
+
+            for (unsigned int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                cpus.push_back(cpu);
+        }
+
+        std::map<int, int> node_of_cpu;
+        for (int node = 0; node < mMaxNodes; ++node){
+
+            std::string cpu_list;
+            if (!ReadFirstLine(p_SysfsRoot + "/node/node" + std::to_string(node) + "/cpulist", cpu_list))
+                continue;
+            for (int cpu : ParseCpuList(cpu_list))
+                node_of_cpu[cpu] = node;
+        }
+
+        for (int cpu : cpus){
+
+            const std::string topology = p_SysfsRoot + "/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            LogicalCpu logical_cpu;
+            logical_cpu.cpu = cpu;
+            logical_cpu.core = ReadInt(topology + "core_id", cpu);
+            logical_cpu.package = ReadInt(topology + "physical_package_id", 0);
+            logical_cpu.node = node_of_cpu.count(cpu) ? node_of_cpu[cpu] : 0;
+            mCpus.push_back(logical_cpu);
+        }
+    }
+
+    /*
+     * @brief       parse kernel cpu list format "0-3,8,10-11"
+     *
+     * @return      cpu numbers in the order listed, empty on malformed input
+    */
+    static std::vector<int> ParseCpuList(std::string_view p_List){
+
+        std::vector<int> cpus;
+        try{
+
+            while (!p_List.empty()){
+
+                const std::size_t comma = p_List.find(',');
+                std::string_view range = p_List.substr(0, comma);
+                p_List = (comma == std::string_view::npos) ? std::string_view{} : p_List.substr(comma + 1);
+                while (!range.empty() && std::isspace(static_cast<unsigned char>(range.back())))
+                    range.remove_suffix(1);
+                while (!range.empty() && std::isspace(static_cast<unsigned char>(range.front())))
+                    range.remove_prefix(1);
+                if (range.empty())
+                    continue;
+
+                const std::size_t dash = range.find('-');
+                const int first = boost::lexical_cast<int>(range.substr(0, dash));
+                const int last = (dash == std::string_view::npos) ? first : boost::lexical_cast<int>(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(cpu);
+            }
+        }catch(boost::bad_lexical_cast&){
+
+            cpus.clear();
+        }
+        return cpus;
+    }
+
+    const std::vector<LogicalCpu>& Cpus() const{
+
+        return mCpus;
+    }
+
+    std::vector<int> Nodes() const{
+
+        std::set<int> nodes;
+        for (const auto& cpu : mCpus)
+            nodes.insert(cpu.node);
+        return std::vector<int>(nodes.begin(), nodes.end());
+    }
+
+    int NodeOfCpu(int p_Cpu) const{
+
+        for (const auto& cpu : mCpus)
+            if (cpu.cpu == p_Cpu)
+                return cpu.node;
+        return 0;
+    }
+
+private:
+    static bool ReadFirstLine(const std::string& p_Path, std::string& p_Line){
+
+        std::ifstream file(p_Path);
+        return (file && std::getline(file, p_Line));
+    }
+
+    static int ReadInt(const std::string& p_Path, int p_Default){
+
+        std::string line;
+        if (!ReadFirstLine(p_Path, line))
+            return p_Default;
+        try{
+
+            return boost::lexical_cast<int>(line);
+        }catch(boost::bad_lexical_cast&){
+
+            return p_Default;
+        }
+    }
+
+private:
+    static constexpr int mMaxNodes = 64;
+    std::vector<LogicalCpu> mCpus;
+};
+
+/*
+ * Decides which cpus reader/writer threads are pinned to and which NUMA nodes
+ * the cache memory should live on for that placement
+*/
+class ThreadPlacement
+{
+public:
+    ThreadPlacement(const CpuTopology& p_Topology, THREAD_PLACEMENT p_Policy,
+                    const std::vector<int>& p_ReaderCpus = {}, const std::vector<int>& p_WriterCpus = {})
+        :mTopology(p_Topology), mPolicy(p_Policy), mReaderCpus(p_ReaderCpus), mWriterCpus(p_WriterCpus){
+
+        std::vector<LogicalCpu> cpus = mTopology.Cpus();
+        auto compact_order = [](const LogicalCpu& lhs, const LogicalCpu& rhs){
+
+            return std::tie(lhs.node, lhs.package, lhs.core, lhs.cpu) < std::tie(rhs.node, rhs.package, rhs.core, rhs.cpu);
+        };
+        std::sort(cpus.begin(), cpus.end(), compact_order);
+
+        if (mPolicy != THREAD_PLACEMENT::SPREAD){
+
+            for (const auto& cpu : cpus)
+                mOrder.push_back(cpu.cpu);
+            return;
+        }
+
+        // rank of a cpu among its core siblings, every core gets a thread before any sibling does
+        std::map<int, std::vector<std::vector<int>>> node_ranks;
+        std::map<std::tuple<int, int, int>, std::size_t> sibling_rank;
+        for (const auto& cpu : cpus){
+
+            const std::size_t rank = sibling_rank[std::make_tuple(cpu.node, cpu.package, cpu.core)]++;
+            auto& ranks = node_ranks[cpu.node];
+            if (ranks.size() <= rank)
+                ranks.resize(rank + 1);
+            ranks[rank].push_back(cpu.cpu);
+        }
+        std::map<int, std::vector<int>> node_order;
+        for (const auto& [node, ranks] : node_ranks)
+            for (const auto& rank : ranks)
+                node_order[node].insert(node_order[node].end(), rank.begin(), rank.end());
+
+        for (std::size_t i = 0; mOrder.size() < cpus.size(); ++i)
+            for (const auto& [node, order] : node_order)
+                if (i < order.size())
+                    mOrder.push_back(order[i]);
+    }
+
+    /*
+     * @brief       parse the cache.thread_placement option, unknown policy falls back to compact
+     *
+     * @return      placement policy
+    */
+    static THREAD_PLACEMENT ParsePolicy(std::string_view p_Policy){
+
+        if (p_Policy == "spread")
+            return THREAD_PLACEMENT::SPREAD;
+        if (p_Policy == "per_node")
+            return THREAD_PLACEMENT::PER_NODE;
+        if (p_Policy == "explicit")
+            return THREAD_PLACEMENT::EXPLICIT;
+        if (p_Policy != "compact")
+            std::cout << "unknown thread placement " << p_Policy << " using compact" << std::endl;
+        return THREAD_PLACEMENT::COMPACT;
+    }
+
+    /*
+     * @brief       cpus the next thread of p_Role is allowed to run on
+     *
+     * @return      cpu numbers, empty leaves the thread unpinned
+    */
+    std::vector<int> NextCpus(THREAD_ROLE p_Role){
+
+        const std::size_t thread_number = mNextThread[(int)p_Role].fetch_add(1, std::memory_order_relaxed);
+        switch (mPolicy){
+
+            case THREAD_PLACEMENT::PER_NODE:{
+
+                const std::vector<int> nodes = mTopology.Nodes();
+                const int node = nodes[thread_number % nodes.size()];
+                std::vector<int> cpus;
+                for (int cpu : mOrder)
+                    if (mTopology.NodeOfCpu(cpu) == node)
+                        cpus.push_back(cpu);
+                return cpus;
+            }
+            case THREAD_PLACEMENT::EXPLICIT:{
+
+                const std::vector<int>& cpus = (p_Role == THREAD_ROLE::READER) ? mReaderCpus : mWriterCpus;
+                if (cpus.empty())
+                    return {};
+                return {cpus[thread_number % cpus.size()]};
+            }
+            default:{
+
+                // readers and writers count separately so both start on the first cpus of the order
+                return {mOrder[thread_number % mOrder.size()]};
+            }
+        }
+    }
+
+    /*
+     * @brief       pin p_Thread as the next thread of p_Role
+     *
+     * @return      pthread_setaffinity_np result, 0 on success
+    */
+    int Pin(std::thread& p_Thread, THREAD_ROLE p_Role){
+
+        const std::vector<int> cpus = NextCpus(p_Role);
+        if (cpus.empty())
+            return 0;
+
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &cpuset);
+        return pthread_setaffinity_np(p_Thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+    }
+
+    /*
+     * @brief       NUMA nodes the pinned threads run on, cache memory should be placed there
+     *
+     * @return      node numbers
+    */
+    std::vector<int> MemoryNodes() const{
+
+        std::set<int> nodes;
+        switch (mPolicy){
+
+            case THREAD_PLACEMENT::COMPACT:
+                nodes.insert(mTopology.NodeOfCpu(mOrder.front()));
+                break;
+            case THREAD_PLACEMENT::EXPLICIT:
+                for (int cpu : mReaderCpus)
+                    nodes.insert(mTopology.NodeOfCpu(cpu));
+                for (int cpu : mWriterCpus)
+                    nodes.insert(mTopology.NodeOfCpu(cpu));
+                break;
+            default:
+                break;
+        }
+        if (nodes.empty())
+            return mTopology.Nodes();
+        return std::vector<int>(nodes.begin(), nodes.end());
+    }
+
+    std::size_t NumberOfNodes() const{
+
+        return mTopology.Nodes().size();
+    }
+
+private:
+    const CpuTopology mTopology;
+    const THREAD_PLACEMENT mPolicy;
+    const std::vector<int> mReaderCpus;
+    const std::vector<int> mWriterCpus;
+    std::vector<int> mOrder;                                            //cpu order threads are handed out
+    std::atomic<std::size_t> mNextThread[2] = {0, 0};
+};
+
+/*
+ * @brief       move already touched pages of [p_Address, p_Address + p_Length) to p_Nodes
+ *              and keep future faults there, one node is preferred several are interleaved
+ *              single node machines have nothing to move
+ *
+ * @return      true if the kernel accepted the policy
+*/
+inline bool BindMemoryToNodes(const void* p_Address, std::size_t p_Length, const std::vector<int>& p_Nodes){
+
+    unsigned long node_mask = 0;
+    for (int node : p_Nodes)
+        if (node >= 0 && node < (int)(sizeof(node_mask) * 8))
+            node_mask |= (1UL << node);
+    if (node_mask == 0 || p_Length == 0)
+        return false;
+
+    const uintptr_t page_size = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(p_Address) & ~(page_size - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(p_Address) + p_Length + page_size - 1) & ~(page_size - 1);
+    const int mode = (p_Nodes.size() == 1) ? MPOL_PREFERRED : MPOL_INTERLEAVE;
+    return (::syscall(SYS_mbind, begin, end - begin, mode, &node_mask, sizeof(node_mask) * 8, MPOL_MF_MOVE) == 0);
+}
+
+#endif // TOPOLOGY_H
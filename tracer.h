@@ -0,0 +1,301 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <unistd.h>
+
+enum class TRACE_EVENT: uint8_t{
+
+    GET_NEW_BUFFER = 0,     //buffer handed out for a miss, reclaimed or evicted
+    EVICT,                  //victim scan, claim and drop (with its synchronous write if DIRTY)
+    FLUSH,
+    WRITE_ITEM,             //items file update
+    MSYNC,                  //mapped items file flush / fdatasync of the record file
+    ITEM_FILE_LOCK,         //waited for mItemFileGuard
+    MAP_LOCK,               //waited for the hash map lock
+    RETRY_SLEEP,            //lost a CAS on a buffer and backed off
+    MAX_EVENT
+};
+
+/*
+ * Flight recorder of timestamped spans, one ring per recording thread so recording is a few relaxed
+ * stores with no lock or shared cache line. A full ring overwrites its oldest events, export copies
+ * what is left and writes Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+ *  # - off (the default) a span costs one relaxed load, rings are allocated on the first recorded event
+ *  # - export may run while threads record, slots overwritten during the copy are dropped not torn
+*/
+class EventTracer
+{
+public:
+    static constexpr std::size_t mRingCapacity = 4096;                  //events kept per thread
+
+    static EventTracer& Instance(){
+
+        static EventTracer tracer;
+        return tracer;
+    }
+
+    EventTracer(const EventTracer&) = delete;
+    EventTracer& operator=(const EventTracer&) = delete;
+
+    void Enable(bool p_Enabled){
+
+        mEnabled.store(p_Enabled, std::memory_order_relaxed);
+    }
+
+    bool Enabled() const{
+
+        return mEnabled.load(std::memory_order_relaxed);
+    }
+
+    // nanoseconds since the tracer was created
+    uint64_t Now() const{
+
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mEpoch).count());
+    }
+
+    void Record(TRACE_EVENT p_Event, uint64_t p_Begin, uint64_t p_End, uint64_t p_Argument){
+
+        ThreadRing().Push(p_Event, p_Begin, p_End - p_Begin, p_Argument);
+    }
+
+    // forget what was recorded so far, the next export starts from here
+    void Clear(){
+
+        std::lock_guard lk(mRingsGuard);
+        for (const auto& ring : mRings)
+            ring->floor.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+
+    /*
+     * @brief       write every event still in the rings as Chrome trace "complete" events,
+     *              one trace thread per recording thread, times in microseconds
+     *
+     * @return      number of events written
+    */
+    std::size_t ExportChromeTrace(std::ostream& p_Out) const{
+
+        static const char* event_names[] = {"get_new_buffer", "evict", "flush", "write_item", "msync", "item_file_lock", "map_lock", "retry_sleep"};
+        static_assert(sizeof(event_names) / sizeof(event_names[0]) == (std::size_t)TRACE_EVENT::MAX_EVENT);
+
+        std::vector<std::shared_ptr<Ring>> rings;
+        {
+            std::lock_guard lk(mRingsGuard);
+            rings = mRings;
+        }
+
+        const int pid = ::getpid();
+        std::size_t written = 0;
+        const char* separator = "";
+        p_Out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        p_Out << std::fixed << std::setprecision(3);
+        for (const auto& ring : rings){
+
+            p_Out << separator << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << ring->thread
+                  << ",\"args\":{\"name\":\"cache thread " << ring->thread << "\"}}";
+            separator = ",";
+            for (const Event& event : ring->Snapshot()){
+
+                p_Out << ",\n{\"name\":\"" << event_names[(int)event.type] << "\",\"cat\":\"cache\",\"ph\":\"X\",\"pid\":" << pid
+                      << ",\"tid\":" << ring->thread << ",\"ts\":" << (event.begin / 1000.0) << ",\"dur\":" << (event.duration / 1000.0)
+                      << ",\"args\":{\"arg\":" << event.argument << "}}";
+                ++written;
+            }
+        }
+        p_Out << "\n]}\n";
+        return written;
+    }
+
+    bool ExportChromeTrace(const std::string& p_FileName) const{
+
+        std::ofstream out(p_FileName, std::ios::trunc);
+        if (!out)
+            return false;
+        ExportChromeTrace(out);
+        return static_cast<bool>(out);
+    }
+
+private:
+    EventTracer() = default;
+
+    struct Event{
+
+        uint64_t begin;
+        uint64_t duration;
+        uint64_t argument;
+        TRACE_EVENT type;
+    };
+
+    struct Ring{
+
+        static constexpr uint64_t mArgumentMask = (uint64_t(1) << 56) - 1;
+
+        struct Slot{
+
+            std::atomic<uint64_t> begin{0};
+            std::atomic<uint64_t> duration{0};
+            std::atomic<uint64_t> tagged{0};                            //event type in the top byte, argument below
+        };
+
+        explicit Ring(uint32_t p_Thread)
+            :thread(p_Thread), slots(new Slot[mRingCapacity]){}
+
+        // only the owning thread pushes
+        void Push(TRACE_EVENT p_Event, uint64_t p_Begin, uint64_t p_Duration, uint64_t p_Argument){
+
+            const uint64_t index = head.load(std::memory_order_relaxed);
+            Slot& slot = slots[index & (mRingCapacity - 1)];
+            // a Snapshot that sees any of the slot stores also sees the reservation and drops the slot
+            reserved.store(index + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.begin.store(p_Begin, std::memory_order_relaxed);
+            slot.duration.store(p_Duration, std::memory_order_relaxed);
+            slot.tagged.store((uint64_t(p_Event) << 56) | (p_Argument & mArgumentMask), std::memory_order_relaxed);
+            head.store(index + 1, std::memory_order_release);
+        }
+
+        std::vector<Event> Snapshot() const{
+
+            const uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t begin = std::max(floor.load(std::memory_order_relaxed), end > mRingCapacity ? end - mRingCapacity : 0);
+            std::vector<Event> events;
+            events.reserve(end - begin);
+            for (uint64_t index = begin; index < end; ++index){
+
+                const Slot& slot = slots[index & (mRingCapacity - 1)];
+                const uint64_t tagged = slot.tagged.load(std::memory_order_relaxed);
+                events.push_back(Event{slot.begin.load(std::memory_order_relaxed), slot.duration.load(std::memory_order_relaxed),
+                                       tagged & mArgumentMask, static_cast<TRACE_EVENT>(tagged >> 56)});
+            }
+
+            // slots the owner reused meanwhile (the one being written included) may be mixed, drop them
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t now = reserved.load(std::memory_order_relaxed);
+            if (now > mRingCapacity && now - mRingCapacity > begin){
+
+                const uint64_t stale = std::min<uint64_t>(now - mRingCapacity - begin, events.size());
+                events.erase(events.begin(), events.begin() + stale);
+            }
+            return events;
+        }
+
+        const uint32_t thread;
+        std::atomic<uint64_t> head{0};                                  //events ever pushed
+        std::atomic<uint64_t> reserved{0};                              //head plus the event being pushed
+        std::atomic<uint64_t> floor{0};                                 //events before it were cleared
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    // rings outlive their threads so events of finished threads can still be exported
+    Ring& ThreadRing(){
+
+        thread_local Ring* ring = nullptr;
+        if (ring == nullptr){
+
+            std::lock_guard lk(mRingsGuard);
+            mRings.push_back(std::make_shared<Ring>(static_cast<uint32_t>(mRings.size() + 1)));
+            ring = mRings.back().get();
+        }
+        return *ring;
+    }
+
+private:
+    std::atomic<bool> mEnabled{false};
+    const std::chrono::steady_clock::time_point mEpoch = std::chrono::steady_clock::now();
+    mutable std::mutex mRingsGuard;
+    std::vector<std::shared_ptr<Ring>> mRings;
+};
+
+/*
+ * Records the scope it lives in as one event when tracing was on at its start
+*/
+class TraceSpan
+{
+public:
+    explicit TraceSpan(TRACE_EVENT p_Event, uint64_t p_Argument = 0)
+        :mEvent(p_Event), mArgument(p_Argument){
+
+        EventTracer& tracer = EventTracer::Instance();
+        if (tracer.Enabled()){
+
+            mRecording = true;
+            mBegin = tracer.Now();
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan(){
+
+        if (mRecording){
+
+            EventTracer& tracer = EventTracer::Instance();
+            tracer.Record(mEvent, mBegin, tracer.Now(), mArgument);
+        }
+    }
+
+private:
+    const TRACE_EVENT mEvent;
+    const uint64_t mArgument;
+    bool mRecording = false;
+    uint64_t mBegin = 0;
+};
+
+/*
+ * @brief       lock p_Mutex with a Lock (std::unique_lock, std::shared_lock), the wait is recorded
+ *              as p_Event only when tracing is on and the lock was contended
+ *
+ * @return      owning lock
+*/
+template<typename Lock, typename Mutex>
+Lock AcquireTraced(Mutex& p_Mutex, TRACE_EVENT p_Event){
+
+    if (!EventTracer::Instance().Enabled())
+        return Lock(p_Mutex);
+
+    Lock lock(p_Mutex, std::try_to_lock);
+    if (!lock.owns_lock()){
+
+        TraceSpan wait(p_Event);
+        lock.lock();
+    }
+    return lock;
+}
+
+#endif // TRACER_H
@@ -46,19 +46,273 @@ struct alignas (64) LFUCacheBuffer{
     //short counter_4_aba;
 };
 
+/*
+ * Same buffer without the cache line padding so 4 of them share a line, victim scan of the dense layout
+ * reads EvictionKeys instead of the buffers so it does not need one line per buffer
+*/
+template<typename Key = short, typename Value = signed int>
+struct DenseLFUCacheBuffer{
+
+    short frequency;
+    short status;
+    Value data;
+};
+
+enum class SLOT_LAYOUT: int8_t{
+
+    PADDED = 0,             //one buffer per cache line
+    DENSE,                  //DenseLFUCacheBuffer plus dense eviction keys
+};
+
+/*
+ * Handle to a variable length value kept in SlabAllocator, small enough to live in the atomic buffer.
+ * generation is bumped each time the chunk is released so a reader holding a stale copy can detect reuse
+*/
+struct SlabHandle{
+
+    static constexpr uint32_t INVALID_CHUNK = 0xFFFFFFFF;
+
+    uint32_t chunk = INVALID_CHUNK;                 //size class in top 4 bits, chunk index in the rest
+    uint32_t generation = 0;
+    uint32_t length = 0;
+};
+
+enum class WRITE_MODE: int8_t{
+
+    WRITE_BACK = 0,         //Put leaves the buffer DIRTY, writeback thread/eviction persists it
+    WRITE_THROUGH,          //Put persists right away, buffer stays clean
+    WRITE_AROUND,           //Put goes to the items file only and drops the cached copy
+};
+
+/*
+ * How the buffer pool and reverse index got their pages and how much of them (and of the
+ * items file mapping) the kernel really backs with huge pages right now
+*/
+struct HugePageStats{
+
+    bool hugeTlb = false;                               //MAP_HUGETLB succeeded
+    bool transparent = false;                           //madvise(MADV_HUGEPAGE) accepted
+    std::size_t mappedBytes = 0;                        //allocated through HugePageAllocator
+    std::size_t backedBytes = 0;                        //of them on huge pages
+    std::size_t itemFileBackedBytes = 0;
+};
+
+/*
+ * Memory actually used by a cache, payload bytes are slab chunks handed out, reserved are whole slab pages
+ * backed by memory, the budget and the total count reserved ones
+*/
+struct CacheMemoryUsage{
+
+    std::size_t bufferBytes = 0;
+    std::size_t indexBytes = 0;
+    std::size_t payloadBytes = 0;
+    std::size_t reservedPayloadBytes = 0;
+    std::size_t budgetBytes = 0;
+    std::size_t numberOfEntries = 0;
+    HugePageStats hugePages;
+
+    std::size_t Total() const{
+
+        return (bufferBytes + indexBytes + reservedPayloadBytes);
+    }
+};
+
+/*
+ * Prefetched keys loaded by readahead and how many of them were hit before being evicted
+*/
+struct ReadaheadStats{
+
+    std::size_t admitted = 0;
+    std::size_t used = 0;
+};
+
+/*
+ * When the writeback thread writes dirty buffers back (BDFLUSHR/NAUTOUP of the unix buffer cache)
+*/
+struct WritebackPolicy{
+
+    std::chrono::milliseconds interval{5000};          //periodic wake up
+    std::chrono::milliseconds delayedWriteAge{0};      //dirty longer than this is written on wake up
+    double dirtyRatio = 0;                              //fraction of dirty buffers that wakes writeback, 0 never
+    std::size_t buffersPerSecond = 0;                   //rate limit, 0 unlimited
+};
+
+/*
+ * Compressed tier of evicted entries, hits are entries promoted back into the buffer cache
+*/
+struct WarmTierStats{
+
+    std::size_t budgetBytes = 0;
+    std::size_t usedBytes = 0;
+    std::size_t entries = 0;
+    std::size_t blocks = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t inserted = 0;
+    std::size_t dropped = 0;                            //entries of blocks dropped for the budget
+};
+
+/*
+ * Estimated hit ratio of the cache at other sizes, from the sampled stack distance profile
+*/
+struct MissRatioPoint{
+
+    std::size_t capacity = 0;                           //number of buffers
+    double hitRatio = 0;
+};
+
+struct MissRatioCurve{
+
+    double sampleRate = 0;                              //0 profiling off
+    std::size_t sampledReferences = 0;
+    std::size_t trackedKeys = 0;
+    std::vector<MissRatioPoint> points;
+};
+
+/*
+ * Get misses, concurrent misses of one key are coalesced into a single load
+*/
+struct MissStats{
+
+    std::size_t loads = 0;                              //values read from the warm tier or items file
+    std::size_t coalesced = 0;                          //misses that waited for another thread's load
+};
+
+enum class PERF_EVENT: int8_t{
+
+    CYCLES = 0,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    DTLB_MISSES,
+    BRANCH_MISSES,
+    MAX_EVENT
+};
+
+enum class PERF_OPERATION: int8_t{
+
+    GET = 0,
+    PUT,
+    EVICT,
+    FLUSH,
+    MAX_OPERATION
+};
+
+struct PerfReading{
+
+    uint64_t nanoseconds = 0;
+    uint64_t enabled = 0;                               //ns the counter group was enabled
+    uint64_t running = 0;                               //ns of that it was really on the PMU
+    std::array<uint64_t, (int)PERF_EVENT::MAX_EVENT> counts{};
+};
+
+/*
+ * Hardware counter totals of one kind of operation, events are of the counted operations only
+ * (the ones the counters were scheduled for), scaled up where they were multiplexed
+*/
+struct PerfOperationStats{
+
+    std::size_t operations = 0;
+    std::size_t countedOperations = 0;
+    uint64_t nanoseconds = 0;
+    std::array<uint64_t, (int)PERF_EVENT::MAX_EVENT> events{};
+
+    double PerOperation(PERF_EVENT p_Event) const{
+
+        return countedOperations ? static_cast<double>(events[(int)p_Event]) / countedOperations : 0;
+    }
+};
+
+struct PerfStats{
+
+    uint32_t availableEvents = 0;                       //bit per PERF_EVENT, 0 only wall time was measured
+    std::array<PerfOperationStats, (int)PERF_OPERATION::MAX_OPERATION> operations;
+
+    bool Available(PERF_EVENT p_Event) const{
+
+        return (availableEvents & (1u << (int)p_Event));
+    }
+
+    // opened and also scheduled for at least one p_Operation
+    bool Available(PERF_OPERATION p_Operation, PERF_EVENT p_Event) const{
+
+        return (Available(p_Event) && operations[(int)p_Operation].countedOperations > 0);
+    }
+};
+
+class PerfCounters;
+
+struct WritebackStats{
+
+    std::size_t dirtyBuffers = 0;
+    std::size_t written = 0;                            //by writeback thread/Flush/write through
+    std::size_t writtenThrough = 0;                     //Puts persisted synchronously
+    std::size_t writtenAround = 0;                      //Puts that went to the items file without a buffer
+    std::size_t dirtyEvictions = 0;                     //victim had to be written synchronously
+    std::size_t cleanEvictions = 0;
+    std::size_t cleanLoads = 0;                         //misses loaded VALID, nothing to write back
+    std::size_t unchangedWrites = 0;                    //Puts of the value already cached, buffer left as it was
+
+    // writes the items file was spared compared to marking every load and update DIRTY
+    std::size_t WritebacksAvoided() const{
+
+        return (cleanLoads + unchangedWrites);
+    }
+};
+
+/*
+ * One resident entry as seen by a snapshot, all fields come from the same version of its buffer
+*/
+template<typename Key, typename Value>
+struct CacheEntry{
+
+    Key key;
+    Value value;
+    short frequency = 0;
+    bool dirty = false;                                 //not written back to the items file yet
+};
+
 template<typename Key, typename Value>
 class ICacheInterface {
 public:
 
     virtual bool GetCachedValue(int p_Index, Value& p_Value) = 0;
-    virtual void SetCachedValue(int p_Index,const Value& p_Value) = 0;
+    virtual bool SetCachedValue(int p_Index,const Value& p_Value) = 0;
+    virtual std::size_t DrainReadBuffers() = 0;
+    virtual std::size_t AgeFrequencies() = 0;
     virtual const bool Get(const Key& p_Position, Value& p_PositionValue) = 0;
     virtual void Put(const Key& p_Position, const Value& p_Value)  = 0;
+    virtual void Put(const Key& p_Position, const Value& p_Value, std::chrono::milliseconds p_TimeToLive)  = 0;
+    virtual bool Lookup(const Key& p_Position, Value& p_Value) = 0;
+    virtual bool Remove(const Key& p_Position) = 0;
     virtual void Flush() = 0;
+    virtual void SetWritebackPolicy(const WritebackPolicy& p_Policy) = 0;
+    virtual bool SetWriteMode(WRITE_MODE p_Mode) = 0;
+    virtual std::size_t Writeback(std::chrono::milliseconds p_MaxWait) = 0;
+    virtual WritebackStats WritebackStatistics() const = 0;
+    virtual std::size_t AdvanceTimers() = 0;
+    virtual void SetDefaultTimeToLive(std::chrono::milliseconds p_TimeToLive) = 0;
+    virtual void SetExpiryRemoves(bool p_Remove) = 0;
+    virtual std::chrono::milliseconds TimerResolution() const = 0;
+    virtual void SetMemoryBudget(std::size_t p_Bytes) = 0;
+    virtual CacheMemoryUsage MemoryUsage() const = 0;
+    virtual void SetReadahead(std::size_t p_Depth) = 0;
+    virtual std::size_t Readahead(std::chrono::milliseconds p_MaxWait) = 0;
+    virtual ReadaheadStats ReadaheadStatistics() const = 0;
+    virtual bool PlaceMemory(const std::vector<int>& p_Nodes) = 0;
+    virtual void SetWarmTierBudget(std::size_t p_Bytes) = 0;
+    virtual WarmTierStats WarmTierStatistics() const = 0;
+    virtual MissStats MissStatistics() const = 0;
+    virtual void SetPerfCounters(PerfCounters* p_Counters) = 0;
+    virtual bool Resize(std::size_t p_NumberOfBuffers) = 0;
+    virtual std::size_t RelocateBuffers(std::size_t p_MaxBuffers) = 0;
+    virtual std::size_t NumberOfBuffers() const = 0;
+    virtual std::size_t ForEachEntry(const std::function<bool(const CacheEntry<Key, Value>&)>& p_Visitor) = 0;
 };
 
-template<ALGO policy, typename Key, typename Value> struct FreeListContentType { using type = LFUCacheBuffer<Key, Value>; };
-template<typename Key, typename Value> struct FreeListContentType<ALGO::LFU, Key, Value> { using type = LFUCacheBuffer<Key, Value>; };
+template<ALGO policy, typename Key, typename Value, SLOT_LAYOUT layout = SLOT_LAYOUT::PADDED> struct FreeListContentType { using type = LFUCacheBuffer<Key, Value>; };
+template<typename Key, typename Value> struct FreeListContentType<ALGO::LFU, Key, Value, SLOT_LAYOUT::PADDED> { using type = LFUCacheBuffer<Key, Value>; };
+template<typename Key, typename Value> struct FreeListContentType<ALGO::LFU, Key, Value, SLOT_LAYOUT::DENSE> { using type = DenseLFUCacheBuffer<Key, Value>; };
 
 
 #endif /* UTIL_HPP */
@@ -0,0 +1,125 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef VALUE_STORAGE_H
+#define VALUE_STORAGE_H
+
+#include <string>
+#include <boost/lexical_cast.hpp>
+
+#include "slaballocator.h"
+
+/*
+ * Decides how a Value is kept inside the atomic cache buffer and in the items file.
+ * Trivially copyable scalars are stored inline as before, anything else needs a specialization
+*/
+template<typename Value>
+struct ValueStorage{
+
+    using stored_type = Value;
+    static constexpr bool fits_fixed_width = true;
+
+    static stored_type Store(SlabAllocator&, const Value& p_Value){
+
+        return p_Value;
+    }
+
+    static bool Load(const SlabAllocator&, const stored_type& p_Stored, Value& p_Value){
+
+        p_Value = p_Stored;
+        return true;
+    }
+
+    static void Release(SlabAllocator&, const stored_type&){}
+
+    static bool Serialize(const SlabAllocator&, const stored_type& p_Stored, std::string& p_Record){
+
+        p_Record = std::to_string(p_Stored);
+        return true;
+    }
+
+    // an update with the value already cached leaves the buffer clean
+    static bool Equals(const SlabAllocator&, const stored_type& p_Stored, const Value& p_Value){
+
+        return (p_Stored == p_Value);
+    }
+
+    // record of a value that is not in a buffer (write around)
+    static void Format(const Value& p_Value, std::string& p_Record){
+
+        p_Record = std::to_string(p_Value);
+    }
+
+    static void Parse(const std::string& p_Record, Value& p_Value){
+
+        p_Value = p_Record.empty() ? Value{} : boost::lexical_cast<Value>(p_Record);
+    }
+};
+
+/*
+ * Strings/serialized blobs live in the slab allocator, the buffer only holds handle and length
+*/
+template<>
+struct ValueStorage<std::string>{
+
+    using stored_type = SlabHandle;
+    static constexpr bool fits_fixed_width = false;
+
+    static stored_type Store(SlabAllocator& p_Allocator, const std::string& p_Value){
+
+        return p_Allocator.Allocate(p_Value);
+    }
+
+    static bool Load(const SlabAllocator& p_Allocator, const stored_type& p_Stored, std::string& p_Value){
+
+        return p_Allocator.Read(p_Stored, p_Value);
+    }
+
+    static void Release(SlabAllocator& p_Allocator, const stored_type& p_Stored){
+
+        p_Allocator.Release(p_Stored);
+    }
+
+    static bool Serialize(const SlabAllocator& p_Allocator, const stored_type& p_Stored, std::string& p_Record){
+
+        return p_Allocator.Read(p_Stored, p_Record);
+    }
+
+    static bool Equals(const SlabAllocator& p_Allocator, const stored_type& p_Stored, const std::string& p_Value){
+
+        return p_Allocator.Equals(p_Stored, p_Value);
+    }
+
+    static void Format(const std::string& p_Value, std::string& p_Record){
+
+        p_Record = p_Value;
+    }
+
+    static void Parse(const std::string& p_Record, std::string& p_Value){
+
+        p_Value = p_Record;
+    }
+};
+
+#endif // VALUE_STORAGE_H
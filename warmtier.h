@@ -0,0 +1,321 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+
+#ifndef WARM_TIER_H
+#define WARM_TIER_H
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+#include "utilstructs.h"
+
+/*
+ * Second, compact tier for entries evicted from the buffer cache, checked before the items file.
+ * Entries are packed into blocks of neighbouring keys, each entry is varint(key delta), varint(length)
+ * and the record as written to the items file, so an entry costs a few bytes instead of a buffer,
+ * a hash map node and a slab chunk.
+ *  # - integral keys: a block holds mKeysPerBlock consecutive keys sorted, deltas are mostly 1 byte
+ *  # - other keys (StringKey) are spread over mHashedBlocks blocks by hash and stored with their bytes
+ *  # - only clean copies (already in the items file) are kept so dropping a block never loses data
+ *  # - over the budget whole least recently used blocks are dropped
+ * A hit takes the entry out, the caller promotes it back into the buffer cache.
+*/
+template<typename Key>
+class WarmTier
+{
+public:
+    static constexpr uint32_t mKeyBlockBits = 6;
+    static constexpr std::size_t mKeysPerBlock = std::size_t(1) << mKeyBlockBits;
+    static constexpr std::size_t mHashedBlocks = 4096;
+    // hash map node, LRU list node and the block header next to the packed bytes
+    static constexpr std::size_t mBlockOverhead = 96;
+
+    explicit WarmTier(std::size_t p_BudgetBytes = 0)
+        :mBudget(p_BudgetBytes){}
+
+    WarmTier(const WarmTier&) = delete;
+    WarmTier& operator=(const WarmTier&) = delete;
+
+    // 0 disables the tier and drops what it holds
+    void SetBudget(std::size_t p_BudgetBytes){
+
+        std::lock_guard lk(mGuard);
+        mBudget.store(p_BudgetBytes, std::memory_order_relaxed);
+        Shrink();
+    }
+
+    bool Enabled() const{
+
+        return (mBudget.load(std::memory_order_relaxed) != 0);
+    }
+
+    /*
+     * @brief       keep p_Record (what the items file holds for p_Key), replaces an older copy
+     *
+     * @return      void
+    */
+    void Insert(const Key& p_Key, const std::string& p_Record){
+
+        if (!Enabled())
+            return;
+
+        std::lock_guard lk(mGuard);
+        auto [block, entries] = Unpack(p_Key);
+        auto itr = std::find_if(entries.begin(), entries.end(), [&p_Key](const auto& p_Entry){ return p_Entry.first == p_Key; });
+        if (itr != entries.end())
+            itr->second = p_Record;
+        else
+            entries.insert(std::upper_bound(entries.begin(), entries.end(), p_Key, Before), {p_Key, p_Record});
+        Pack(block, entries);
+        mInserted++;
+        Shrink();
+    }
+
+    /*
+     * @brief       move the entry of p_Key out of the tier
+     *
+     * @return      true if p_Record holds the value of p_Key
+    */
+    bool Take(const Key& p_Key, std::string& p_Record){
+
+        if (!Enabled())
+            return false;
+
+        std::lock_guard lk(mGuard);
+        auto [block, entries] = Unpack(p_Key);
+        auto itr = std::find_if(entries.begin(), entries.end(), [&p_Key](const auto& p_Entry){ return p_Entry.first == p_Key; });
+        if (itr == entries.end()){
+
+            mMisses++;
+            return false;
+        }
+        p_Record = std::move(itr->second);
+        entries.erase(itr);
+        Pack(block, entries);
+        mHits++;
+        return true;
+    }
+
+    // stale once the key got a new value (or was removed)
+    bool Erase(const Key& p_Key){
+
+        if (!Enabled())
+            return false;
+
+        std::lock_guard lk(mGuard);
+        auto [block, entries] = Unpack(p_Key);
+        auto itr = std::find_if(entries.begin(), entries.end(), [&p_Key](const auto& p_Entry){ return p_Entry.first == p_Key; });
+        if (itr == entries.end())
+            return false;
+        entries.erase(itr);
+        Pack(block, entries);
+        return true;
+    }
+
+    WarmTierStats Statistics() const{
+
+        std::lock_guard lk(mGuard);
+        WarmTierStats stats;
+        stats.budgetBytes = mBudget.load(std::memory_order_relaxed);
+        stats.usedBytes = mUsedBytes;
+        stats.entries = mEntries;
+        stats.blocks = mBlocks.size();
+        stats.hits = mHits;
+        stats.misses = mMisses;
+        stats.inserted = mInserted;
+        stats.dropped = mDropped;
+        return stats;
+    }
+
+private:
+    using block_id = uint64_t;
+    using entry_list = std::vector<std::pair<Key, std::string>>;
+
+    struct Block{
+
+        std::string bytes;
+        std::size_t entries = 0;
+        typename std::list<block_id>::iterator lru;
+    };
+
+    static block_id BlockOf(const Key& p_Key){
+
+        if constexpr (std::is_integral_v<Key>)
+            return static_cast<block_id>(static_cast<int64_t>(p_Key) >> mKeyBlockBits);
+        else
+            return static_cast<block_id>(std::hash<Key>{}(p_Key) % mHashedBlocks);
+    }
+
+    static bool Before(const Key& lhs, const std::pair<Key, std::string>& rhs){
+
+        if constexpr (std::is_integral_v<Key>)
+            return lhs < rhs.first;
+        else
+            return false;
+    }
+
+    static void PutVarint(std::string& p_Bytes, uint64_t p_Value){
+
+        while (p_Value >= 0x80){
+
+            p_Bytes.push_back(static_cast<char>((p_Value & 0x7F) | 0x80));
+            p_Value >>= 7;
+        }
+        p_Bytes.push_back(static_cast<char>(p_Value));
+    }
+
+    static uint64_t GetVarint(std::string_view p_Bytes, std::size_t& p_Offset){
+
+        uint64_t value = 0;
+        for (uint32_t shift = 0; p_Offset < p_Bytes.size(); shift += 7){
+
+            const uint8_t byte = static_cast<uint8_t>(p_Bytes[p_Offset++]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                break;
+        }
+        return value;
+    }
+
+    // caller must hold mGuard
+    std::pair<block_id, entry_list> Unpack(const Key& p_Key) const{
+
+        const block_id block = BlockOf(p_Key);
+        entry_list entries;
+        auto itr = mBlocks.find(block);
+        if (itr == mBlocks.end())
+            return {block, entries};
+
+        const std::string_view bytes = itr->second.bytes;
+        entries.reserve(itr->second.entries);
+        [[maybe_unused]] int64_t previous = static_cast<int64_t>(block) * (int64_t)mKeysPerBlock;
+        std::size_t offset = 0;
+        while (offset < bytes.size()){
+
+            Key key{};
+            if constexpr (std::is_integral_v<Key>){
+
+                previous += static_cast<int64_t>(GetVarint(bytes, offset));
+                key = static_cast<Key>(previous);
+            }else{
+
+                const std::size_t length = GetVarint(bytes, offset);
+                key = Key(bytes.substr(offset, length));
+                offset += length;
+            }
+            const std::size_t length = GetVarint(bytes, offset);
+            entries.emplace_back(std::move(key), std::string(bytes.substr(offset, length)));
+            offset += length;
+        }
+        return {block, entries};
+    }
+
+    // caller must hold mGuard, an empty list removes the block
+    void Pack(block_id p_Block, const entry_list& p_Entries){
+
+        auto itr = mBlocks.find(p_Block);
+        if (itr != mBlocks.end()){
+
+            mUsedBytes -= itr->second.bytes.size() + mBlockOverhead;
+            mEntries -= itr->second.entries;
+            if (p_Entries.empty()){
+
+                mLru.erase(itr->second.lru);
+                mBlocks.erase(itr);
+                return;
+            }
+            mLru.splice(mLru.begin(), mLru, itr->second.lru);
+        }else{
+
+            if (p_Entries.empty())
+                return;
+            itr = mBlocks.emplace(p_Block, Block{}).first;
+            mLru.push_front(p_Block);
+            itr->second.lru = mLru.begin();
+        }
+
+        std::string bytes;
+        [[maybe_unused]] int64_t previous = static_cast<int64_t>(p_Block) * (int64_t)mKeysPerBlock;
+        for (const auto& [key, record] : p_Entries){
+
+            if constexpr (std::is_integral_v<Key>){
+
+                PutVarint(bytes, static_cast<uint64_t>(static_cast<int64_t>(key) - previous));
+                previous = static_cast<int64_t>(key);
+            }else{
+
+                const std::string_view key_bytes = key.view();
+                PutVarint(bytes, key_bytes.size());
+                bytes.append(key_bytes);
+            }
+            PutVarint(bytes, record.size());
+            bytes.append(record);
+        }
+        bytes.shrink_to_fit();
+        itr->second.bytes = std::move(bytes);
+        itr->second.entries = p_Entries.size();
+        mUsedBytes += itr->second.bytes.size() + mBlockOverhead;
+        mEntries += p_Entries.size();
+    }
+
+    // caller must hold mGuard, drops least recently used blocks until the tier fits its budget
+    void Shrink(){
+
+        const std::size_t budget = mBudget.load(std::memory_order_relaxed);
+        while (!mLru.empty() && mUsedBytes > budget){
+
+            auto itr = mBlocks.find(mLru.back());
+            mUsedBytes -= itr->second.bytes.size() + mBlockOverhead;
+            mEntries -= itr->second.entries;
+            mDropped += itr->second.entries;
+            mBlocks.erase(itr);
+            mLru.pop_back();
+        }
+    }
+
+private:
+    std::atomic<std::size_t> mBudget;
+    std::unordered_map<block_id, Block> mBlocks;
+    std::list<block_id> mLru;                                            //front is most recently used
+    std::size_t mUsedBytes = 0;
+    std::size_t mEntries = 0;
+    std::size_t mHits = 0;
+    std::size_t mMisses = 0;
+    std::size_t mInserted = 0;
+    std::size_t mDropped = 0;
+    mutable std::mutex mGuard;
+};
+
+#endif // WARM_TIER_H
@@ -0,0 +1,121 @@
+//"MIT License
+
+//Copyright (c) 2021 Radhakrishnan Thangavel
+
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+// Author: Radhakrishnan Thangavel (https://github.com/trkinvincible)
+
+#ifndef WRITE_BACK_H
+#define WRITE_BACK_H
+
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <condition_variable>
+
+/*
+ * Wakes the writeback thread before its interval is up, reasons are or-ed until it runs
+*/
+class WritebackTrigger
+{
+public:
+    enum REASON: uint32_t{
+
+        NONE = 0,
+        DIRTY_RATIO = 1,        //dirty buffers crossed the threshold
+        DIRTY_EVICTION = 2,     //eviction had to write back its victim, clean the next ones ahead
+    };
+
+    void Notify(REASON p_Reason){
+
+        {
+            std::lock_guard lk(mTriggerGuard);
+            if ((mReasons & p_Reason) == p_Reason)
+                return;
+            mReasons |= p_Reason;
+        }
+        mTriggerCondition.notify_one();
+    }
+
+    /*
+     * @brief       wait up to p_MaxWait for a notification
+     *
+     * @return      reasons notified since last call, NONE on time out
+    */
+    uint32_t Wait(std::chrono::milliseconds p_MaxWait){
+
+        std::unique_lock lk(mTriggerGuard);
+        mTriggerCondition.wait_for(lk, p_MaxWait, [this](){ return mReasons != NONE; });
+        const uint32_t reasons = mReasons;
+        mReasons = NONE;
+        return reasons;
+    }
+
+private:
+    uint32_t mReasons = NONE;
+    std::mutex mTriggerGuard;
+    std::condition_variable mTriggerCondition;
+};
+
+/*
+ * Token bucket limiting buffers written back per second so writeback does not starve
+ * foreground reads of the items file, 0 rate is unlimited
+*/
+class WritebackRateLimiter
+{
+public:
+    void SetRate(std::size_t p_BuffersPerSecond){
+
+        std::lock_guard lk(mLimiterGuard);
+        mRate = p_BuffersPerSecond;
+        mTokens = static_cast<double>(p_BuffersPerSecond);
+        mLastRefill = std::chrono::steady_clock::now();
+    }
+
+    /*
+     * @brief       take up to p_Wanted tokens
+     *
+     * @return      number of buffers allowed to be written now
+    */
+    std::size_t Acquire(std::size_t p_Wanted){
+
+        std::lock_guard lk(mLimiterGuard);
+        if (mRate == 0)
+            return p_Wanted;
+
+        const auto now = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> elapsed = now - mLastRefill;
+        mLastRefill = now;
+        // one second worth of burst at most
+        mTokens = std::min(static_cast<double>(mRate), mTokens + (elapsed.count() * mRate));
+        const std::size_t granted = std::min(p_Wanted, static_cast<std::size_t>(mTokens));
+        mTokens -= granted;
+        return granted;
+    }
+
+private:
+    std::size_t mRate = 0;
+    double mTokens = 0;
+    std::chrono::steady_clock::time_point mLastRefill = std::chrono::steady_clock::now();
+    std::mutex mLimiterGuard;
+};
+
+#endif // WRITE_BACK_H
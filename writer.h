@@ -34,22 +34,31 @@
 #include <boost/interprocess/mapped_region.hpp>
 #include "command.h"
 #include "fileutility.h"
+#include "mpmcring.h"
 
 extern std::shared_mutex gCheckProgramExit;
 extern std::condition_variable_any gCheckProgramExitConVar;
 
-template<typename DATA>
+template<typename KEY, typename DATA, typename CACHE = CacheManager<KEY, DATA>>
 class Writer : public Command
 {
-    using key_type = typename CacheManager<short, DATA>::key_type;
-    using value_type = typename CacheManager<short, DATA>::value_type;
+    using key_type = typename CACHE::key_type;
+    using value_type = typename CACHE::value_type;
+    using batch_type = std::vector<std::pair<key_type, value_type>>;
+    using ring_type = MpmcRing<batch_type>;
 
 public:
-    Writer(auto cache_manager)
-        :mCacheManager(cache_manager){}
+    Writer(std::shared_ptr<CACHE> cache_manager)
+        :mCacheManager(cache_manager){
+
+        // pipelined ingest: parser threads route batches by key to one ring per applier
+        for (std::size_t i = 0; i < mCacheManager->getConfig().data().writer_appliers; ++i)
+            mRings.push_back(std::make_unique<ring_type>(mRingCapacity));
+    }
 
     virtual ~Writer(){
 
+        joinAppliers();
         std::cout << "Writer Delete..: "<< mCacheManager.use_count() << std::endl;
     }
 
@@ -59,6 +68,14 @@ public:
         std::vector<std::future<std::string>> vec_future;
         const boost::interprocess::file_mapping input_file_mapped(filename.c_str(),boost::interprocess::read_only);
         boost::interprocess::mapped_region mapped_region(input_file_mapped,boost::interprocess::read_only);
+        // appliers of a previous run are done before this one's parsers start
+        joinAppliers();
+        mAllParsersStarted.store(false, std::memory_order_release);
+        for (std::size_t shard = 0; shard < mRings.size(); ++shard){
+
+            mAppliers.emplace_back(&Writer::applyBatches, this, shard);
+            mCacheManager->Placement().Pin(mAppliers.back(), THREAD_ROLE::WRITER);
+        }
         try{
 
             const char* start_address = reinterpret_cast<const char*>(mapped_region.get_address());
@@ -66,29 +83,14 @@ public:
              * Using std::string_view to gurantee "Zero Copying" to yield better performance
             */
             std::string_view input_text(start_address);
-            std::regex r("^.*#");
+            std::regex r(R"([^\n]+)");
             /*
              * raison d'être:
              * linux with fair scheduler will not let thread priority numbers
-             * So find out high clock speed cores and assign high priority task
-             * trick is divide task to run only in designated cores to avoid posibility
-             * of one task blocking other for longer period
+             * so threads are pinned as cache.thread_placement says, close to each other (compact),
+             * one per core (spread), per NUMA node or to explicit cpu lists
             */
-            std::once_flag flg;
-            cpu_set_t cpuset;
-            std::call_once(flg, [&cpuset](){
-
-                CPU_ZERO(&cpuset);
-                /*
-                 * Do hyper-threading for low latency as my i7 can support already with 4 core per processor.
-                 * CPU affinity:
-                 *  0,2, etc.. for writer
-                 *  1,3, etc.. fostartConsumerr reader
-                */
-                for(int cpu_index = 0; cpu_index < mMaxThreadAllowed; cpu_index += 2){
-
-                    CPU_SET(cpu_index,&cpuset);
-            }});
+            ThreadPlacement& placement = mCacheManager->Placement();
             for(std::cregex_iterator i = std::cregex_iterator(input_text.begin(), input_text.end(), r);
                 i != std::cregex_iterator();
                 ++i)
@@ -113,8 +115,9 @@ public:
                     //std::cout << "The file doesn't exist" << std::endl;
                     continue;
                 }
+                mActiveParsers.fetch_add(1, std::memory_order_acq_rel);
                 std::thread t(std::move(task), f);
-                int rc = pthread_setaffinity_np(t.native_handle(),sizeof(cpu_set_t), &cpuset);
+                int rc = placement.Pin(t, THREAD_ROLE::WRITER);
                 if (rc != 0) {
 
                     std::cerr << "Error calling pthread_setaffinity_np: " << rc << std::endl;
@@ -127,6 +130,9 @@ public:
 
             std::cout << "missing writer_file exp: " << exp.what() << std::endl;
         }
+
+        // appliers drain what the parsers still push, then leave, returns right away like the parsers
+        mAllParsersStarted.store(true, std::memory_order_release);
     }
     /*
      * @brief       This method will read the writer file for line number and data to write
@@ -137,6 +143,7 @@ public:
     std::string writeToOutput(std::string filename)
     {
         std::shared_lock lk(gCheckProgramExit);
+        std::vector<batch_type> batches(mRings.size());
         try{
 
             const boost::interprocess::file_mapping input_file_mapped(filename.c_str(),boost::interprocess::read_only);
@@ -144,46 +151,121 @@ public:
             const char* start_address = reinterpret_cast<const char*>(mapped_region.get_address());
             std::string input_text(start_address);
 
-            std::regex r(R"([^.*\n]+)");
+            std::regex r(R"([^\n]+)");
             for(std::sregex_iterator i = std::sregex_iterator(input_text.begin(), input_text.end(), r);
                 i != std::sregex_iterator();
                 ++i)
             {
                 const std::smatch m = *i;
-                const std::string temp = m.str();
-                if (temp.length()){
-
-                    std::vector<std::string> values;
-                    boost::algorithm::split(values, temp, boost::is_any_of(" "));
-                    assert(values.size() >= 2);
-                    if(values.size() >= 2){
-
-                        try{
-                            key_type key = boost::lexical_cast<key_type>(values[0]);
-                            value_type value = boost::lexical_cast<value_type>(values[1]);
-                            //std::cout << __FUNCTION__ << "  Check Point: 1" << std::endl;
-                            mCacheManager->Put(key, value);
-                            //std::cout << __FUNCTION__ << "  Check Point: 10" << std::endl;
-
-                        }catch(std::exception &exp){
-
-                            std::cout << exp.what() << std::endl;
-                            continue;
-                        }
-                    }
+                key_type key;
+                value_type value;
+                if (!parseLine(m.str(), key, value))
+                    continue;
+
+                if (mRings.empty()){
+
+                    mCacheManager->Put(key, value);
+                    continue;
                 }
+                const std::size_t shard = std::hash<key_type>{}(key) % mRings.size();
+                batches[shard].emplace_back(std::move(key), std::move(value));
+                if (batches[shard].size() >= mBatchSize)
+                    pushBatch(shard, batches[shard]);
             }
         }catch(std::exception &exp){
 
             lk.unlock();
             std::cout << exp.what() << std::endl;
         }
+        for (std::size_t shard = 0; shard < batches.size(); ++shard)
+            if (!batches[shard].empty())
+                pushBatch(shard, batches[shard]);
 
+        mActiveParsers.fetch_sub(1, std::memory_order_acq_rel);
         Command::mCurrThreadsAlive.fetch_sub(1, std::memory_order_acq_rel);
         std::cout << "Completed : " << filename << std::endl;
         return "success";
     }
 
+    // wait for every update handed to the appliers to be Put, nothing to wait for without appliers
+    void joinAppliers(){
+
+        for (auto& applier : mAppliers)
+            applier.join();
+        mAppliers.clear();
+    }
+
+private:
+    /*
+     * @brief       split "key value" and convert both
+     *
+     * @return      false for empty or malformed lines
+    */
+    bool parseLine(const std::string& p_Line, key_type& p_Key, value_type& p_Value){
+
+        if (p_Line.empty())
+            return false;
+
+        std::vector<std::string> values;
+        boost::algorithm::split(values, p_Line, boost::is_any_of(" "));
+        assert(values.size() >= 2);
+        if (values.size() < 2)
+            return false;
+
+        try{
+
+            p_Key = KeyTraits<key_type>::Parse(values[0]);
+            p_Value = boost::lexical_cast<value_type>(values[1]);
+        }catch(std::exception &exp){
+
+            std::cout << exp.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // parser side, a full ring means the appliers are behind so the parser waits for them
+    void pushBatch(std::size_t p_Shard, batch_type& p_Batch){
+
+        while (!mRings[p_Shard]->TryPush(p_Batch))
+            std::this_thread::yield();
+        p_Batch = batch_type();
+        p_Batch.reserve(mBatchSize);
+    }
+
+    /*
+     * @brief       applier of one shard, every key of the shard is Put by this thread only so updates
+     *              of a key keep the order its parser read them in, leaves once no parser is left
+     *              and the ring is drained
+     *
+     * @return      void
+    */
+    void applyBatches(std::size_t p_Shard){
+
+        ring_type& ring = *mRings[p_Shard];
+        batch_type batch;
+        for (;;){
+
+            // checked before popping so a batch pushed by the last parser is never left behind
+            const bool parsers_done = mAllParsersStarted.load(std::memory_order_acquire) && mActiveParsers.load(std::memory_order_acquire) == 0;
+            if (!ring.TryPop(batch)){
+
+                if (parsers_done)
+                    return;
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                continue;
+            }
+            for (const auto& [key, value] : batch)
+                mCacheManager->Put(key, value);
+        }
+    }
+
 private:
-    std::shared_ptr<CacheManager<short, DATA>> mCacheManager;
+    static constexpr std::size_t mBatchSize = 64;                       //updates per ring entry
+    static constexpr std::size_t mRingCapacity = 256;                   //batches per shard in flight
+    std::shared_ptr<CACHE> mCacheManager;
+    std::vector<std::unique_ptr<ring_type>> mRings;                     //one per applier, empty applies on the parser
+    std::vector<std::thread> mAppliers;                                 //running after execute returns until parsers are done
+    std::atomic<int> mActiveParsers{0};
+    std::atomic<bool> mAllParsersStarted{false};
 };